@@ -0,0 +1,307 @@
+#include "source.h"
+#include "lexer.h"
+#include "parser.h"
+#include "flat_ast.h"
+#include "codegen.h"
+#include "backend.h"
+#include "cache.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// 编译器前端基准：按参数生成HerCode程序，在进程内反复跑分离、词法、语法、代码生成，
+// 输出每个阶段的统计值以及整体的行/秒和MB/秒。--backend不为none时每次还会调用gcc，
+// 分别测量只包含用到的头文件（used）、包含全部头文件（all）和使用预编译头（pch）时的后端耗时。
+// 用法: hercode_bench [--functions=N] [--says=M] [--fanout=K] [--comments=D]
+//                     [--string-length=L] [--header-lines=H] [--iterations=I]
+//                     [--backend=none|used|all|pch]
+
+typedef struct BenchConfig
+{
+    int functions;     // 函数个数
+    int says;          // 每个函数里的say语句数
+    int fanout;        // 每个函数调用后面多少个函数
+    int comments;      // 每条语句前的注释行数
+    int string_length; // say字符串的长度
+    int header_lines;  // C头部分的行数
+    int iterations;
+} BenchConfig;
+
+typedef struct Buffer
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    int lines;
+} Buffer;
+
+enum
+{
+    PHASE_SPLIT,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_CODEGEN,
+    PHASE_BACKEND,
+    PHASE_TOTAL,
+    PHASE_COUNT
+};
+
+static const char *phase_names[PHASE_COUNT] = {"split", "lex", "parse", "flatten+codegen", "backend", "total"};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append(Buffer *buf, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(Buffer *buf, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    while (buf->length + needed + 1 > buf->capacity)
+    {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 1 << 16;
+        buf->data = realloc(buf->data, buf->capacity);
+        if (!buf->data)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    va_start(args, format);
+    vsnprintf(buf->data + buf->length, needed + 1, format, args);
+    va_end(args);
+    for (int i = 0; i < needed; i++)
+    {
+        if (buf->data[buf->length + i] == '\n')
+            buf->lines++;
+    }
+    buf->length += needed;
+}
+
+static void append_comments(Buffer *buf, const BenchConfig *config, const char *indent)
+{
+    for (int c = 0; c < config->comments; c++)
+        append(buf, "%s# comment line %d: 这是一段说明文字，描述下面这条语句在做什么\n", indent, c);
+}
+
+static void generate_program(const BenchConfig *config, Buffer *buf)
+{
+    for (int h = 0; h < config->header_lines; h++)
+        append(buf, "int header_value_%d = %d;\n", h, h);
+    if (config->header_lines > 0)
+        append(buf, "Hello! Her World\n");
+
+    char *text = malloc(config->string_length + 1);
+    for (int i = 0; i < config->string_length; i++)
+        text[i] = 'a' + i % 26;
+    text[config->string_length] = '\0';
+
+    for (int f = 0; f < config->functions; f++)
+    {
+        append_comments(buf, config, "");
+        append(buf, "function f%d:\n", f);
+        for (int s = 0; s < config->says; s++)
+        {
+            append_comments(buf, config, "\t");
+            append(buf, "\tsay \"%d-%d %s\"\n", f, s, text);
+        }
+        // 只调用编号更大的函数，调用图无环
+        for (int k = 1; k <= config->fanout && f + k < config->functions; k++)
+            append(buf, "\tf%d\n", f + k);
+        append(buf, "end\n");
+    }
+
+    append(buf, "start:\n");
+    if (config->functions > 0)
+        append(buf, "\tf0\n");
+    append(buf, "\tsay \"done\"\nend\n");
+    free(text);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int parse_option(const char *arg, const char *name, int *value)
+{
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = atoi(arg + length + 1);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config = {1000, 10, 2, 1, 64, 20, 30};
+    const char *backend = "none";
+    int precompute = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--backend=", 10) == 0)
+            backend = argv[i] + 10;
+        else if (strcmp(argv[i], "--no-precompute") == 0)
+            precompute = 0;
+        else if (!parse_option(argv[i], "--functions", &config.functions) &&
+            !parse_option(argv[i], "--says", &config.says) &&
+            !parse_option(argv[i], "--fanout", &config.fanout) &&
+            !parse_option(argv[i], "--comments", &config.comments) &&
+            !parse_option(argv[i], "--string-length", &config.string_length) &&
+            !parse_option(argv[i], "--header-lines", &config.header_lines) &&
+            !parse_option(argv[i], "--iterations", &config.iterations))
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (config.iterations < 1)
+        config.iterations = 1;
+    IncludeMode includes = INCLUDE_USED;
+    int run_backend = strcmp(backend, "none") != 0;
+    if (strcmp(backend, "all") == 0)
+        includes = INCLUDE_ALL;
+    else if (strcmp(backend, "pch") == 0)
+        includes = INCLUDE_NONE;
+    else if (run_backend && strcmp(backend, "used") != 0)
+    {
+        fprintf(stderr, "Unknown backend mode: %s\n", backend);
+        return 1;
+    }
+
+    // 后端的输出和预编译头都放在临时目录里，结束时删掉
+    char work_dir[] = "/tmp/hercode_bench_XXXXXX";
+    char executable[sizeof(work_dir) + 8];
+    char *prelude = NULL;
+    BuildCache cache;
+    if (run_backend)
+    {
+        if (!mkdtemp(work_dir))
+        {
+            perror("mkdtemp");
+            return 1;
+        }
+        snprintf(executable, sizeof(executable), "%s/a.out", work_dir);
+        if (cache_open(&cache, work_dir) != 0)
+            return 1;
+        if (includes == INCLUDE_NONE && !(prelude = cache_prepare_pch(&cache, stderr)))
+            return 1;
+    }
+
+    Buffer program = {NULL, 0, 0, 0};
+    generate_program(&config, &program);
+
+    StrBuf c_code;
+    strbuf_init(&c_code);
+
+    double *samples[PHASE_COUNT];
+    for (int p = 0; p < PHASE_COUNT; p++)
+        samples[p] = malloc(config.iterations * sizeof(double));
+
+    Arena arena;
+    arena_init(&arena);
+    FlatAST ast;
+    flat_ast_init(&ast);
+    size_t tokens = 0;
+    for (int it = 0; it < config.iterations; it++)
+    {
+        double t0 = now_seconds();
+        const char *c_header, *hercode_source;
+        size_t c_header_length;
+        separate_header(program.data, program.length, "Hello! Her World",
+                        &c_header, &c_header_length, &hercode_source);
+        if (!hercode_source)
+            hercode_source = program.data;
+
+        double t1 = now_seconds();
+        InternTable strings;
+        intern_init(&strings, &arena);
+        Lexer *lexer = new_lexer(hercode_source);
+        Parser *parser = new_parser(lexer, &arena, &strings);
+
+        double t2 = now_seconds();
+        int node_count;
+        ASTNode **nodes = parse_program(parser, &node_count);
+
+        double t3 = now_seconds();
+        flatten_program(nodes, node_count, &ast);
+        strbuf_reset(&c_code);
+        generate_c_code(c_header, c_header_length, &ast, includes, precompute, &c_code);
+        double t4 = now_seconds();
+        if (run_backend && compile(&c_code, executable, prelude, stderr) != 0)
+            return 1;
+        double t5 = run_backend ? now_seconds() : t4;
+
+        tokens = parser->tokens.count;
+        free_parser(parser);
+        intern_free(&strings);
+        arena_reset(&arena);
+
+        samples[PHASE_SPLIT][it] = t1 - t0;
+        samples[PHASE_LEX][it] = t2 - t1;
+        samples[PHASE_PARSE][it] = t3 - t2;
+        samples[PHASE_CODEGEN][it] = t4 - t3;
+        samples[PHASE_BACKEND][it] = t5 - t4;
+        samples[PHASE_TOTAL][it] = t5 - t0;
+    }
+
+    double mb = program.length / (1024.0 * 1024.0);
+    printf("program: %d functions x %d says, fanout %d, %d comment lines/stmt, %d-byte strings, %d header lines\n",
+           config.functions, config.says, config.fanout, config.comments, config.string_length, config.header_lines);
+    printf("size:    %.2f MB, %d lines, %zu tokens, %d iterations, backend %s (%zu bytes of C)\n\n",
+           mb, program.lines, tokens, config.iterations, backend, c_code.length);
+    printf("%-16s %10s %10s %10s %10s %10s %12s %10s\n",
+           "phase", "min ms", "median ms", "mean ms", "stddev ms", "p90 ms", "Mlines/s", "MB/s");
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        double *s = samples[p];
+        if (p == PHASE_BACKEND && !run_backend)
+        {
+            free(s);
+            continue;
+        }
+        double sum = 0, sum_sq = 0;
+        for (int i = 0; i < config.iterations; i++)
+        {
+            sum += s[i];
+            sum_sq += s[i] * s[i];
+        }
+        qsort(s, config.iterations, sizeof(double), compare_double);
+        double mean = sum / config.iterations;
+        double variance = sum_sq / config.iterations - mean * mean;
+        double median = s[config.iterations / 2];
+        double p90 = s[(int)(config.iterations * 0.9) < config.iterations ? (int)(config.iterations * 0.9) : config.iterations - 1];
+        printf("%-16s %10.3f %10.3f %10.3f %10.3f %10.3f %12.2f %10.1f\n",
+               phase_names[p], s[0] * 1e3, median * 1e3, mean * 1e3, sqrt(variance > 0 ? variance : 0) * 1e3, p90 * 1e3,
+               median > 0 ? program.lines / median / 1e6 : 0, median > 0 ? mb / median : 0);
+        free(s);
+    }
+
+    if (run_backend)
+    {
+        char command[sizeof(work_dir) + 16];
+        snprintf(command, sizeof(command), "rm -rf %s", work_dir);
+        if (system(command) != 0)
+            fprintf(stderr, "Failed to remove %s\n", work_dir);
+        cache_close(&cache);
+        free(prelude);
+    }
+    flat_ast_free(&ast);
+    arena_free(&arena);
+    strbuf_free(&c_code);
+    free(program.data);
+    return 0;
+}
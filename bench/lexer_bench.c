@@ -0,0 +1,96 @@
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 词法分析微基准：生成以长注释和长字符串为主的HerCode源码，反复tokenize并统计吞吐量
+// 用法: hercode_lexer_bench [函数数量] [迭代次数]
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append(char **buf, size_t *len, size_t *cap, const char *text)
+{
+    size_t n = strlen(text);
+    if (*len + n + 1 > *cap)
+    {
+        while (*len + n + 1 > *cap)
+            *cap *= 2;
+        *buf = realloc(*buf, *cap);
+        if (!*buf)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    memcpy(*buf + *len, text, n + 1);
+    *len += n;
+}
+
+static char *generate_source(int functions, size_t *out_len)
+{
+    size_t len = 0, cap = 4096;
+    char *buf = malloc(cap);
+    buf[0] = '\0';
+    char line[512];
+
+    for (int f = 0; f < functions; f++)
+    {
+        append(&buf, &len, &cap, "#==============================================================================\n");
+        append(&buf, &len, &cap, "# 这是一段很长的注释横幅，用来模拟机器生成代码里常见的大段说明文字和版权声明\n");
+        append(&buf, &len, &cap, "#==============================================================================\n");
+        snprintf(line, sizeof(line), "function f%d:\n", f);
+        append(&buf, &len, &cap, line);
+        for (int s = 0; s < 8; s++)
+        {
+            snprintf(line, sizeof(line),
+                     "\tsay \"line %d of function %d: the quick brown fox jumps over the lazy dog, 编程很美,也属于你\" # trailing comment\n",
+                     s, f);
+            append(&buf, &len, &cap, line);
+        }
+        append(&buf, &len, &cap, "end\n");
+    }
+    append(&buf, &len, &cap, "start:\n\tf0\nend\n");
+    *out_len = len;
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    int functions = argc >= 2 ? atoi(argv[1]) : 2000;
+    int iterations = argc >= 3 ? atoi(argv[2]) : 20;
+
+    size_t source_len;
+    char *source = generate_source(functions, &source_len);
+
+    double best = 0;
+    double total = 0;
+    size_t token_count = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        double begin = now_seconds();
+        Lexer *lexer = new_lexer(source);
+        TokenArray tokens;
+        tokenize(lexer, &tokens);
+        double elapsed = now_seconds() - begin;
+        token_count = tokens.count;
+        free_token_array(&tokens);
+        free_lexer(lexer);
+
+        total += elapsed;
+        if (best == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    double mb = source_len / (1024.0 * 1024.0);
+    fprintf(stderr, "source: %.2f MB, %zu tokens, %d iterations\n", mb, token_count, iterations);
+    fprintf(stderr, "best:   %.3f ms  %.1f MB/s\n", best * 1e3, mb / best);
+    fprintf(stderr, "mean:   %.3f ms  %.1f MB/s\n", total / iterations * 1e3, mb / (total / iterations));
+    free(source);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 压力测试：生成超长字符串、深层缩进的大体量HerCode源码，
+// 按规模倍增跑完整前端（词法、语法、代码生成），检查不崩溃且耗时随规模线性增长。
+// 解析失败或者每字节耗时比最小规模时慢MAX_SLOWDOWN倍以上时返回非0
+// 用法: hercode_stress [最大MB数，默认1024] [起始MB数，默认16]
+
+#define LONG_SAY_BYTES 4096 // 每个长字符串的长度
+#define NESTING_DEPTH 512   // 每个函数体内缩进逐行加深的层数
+#define MAX_SLOWDOWN 2.0    // 每字节耗时允许增长的倍数
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 生成约target_bytes字节的源码
+static char *generate_source(size_t target_bytes, size_t *out_len)
+{
+    size_t cap = target_bytes + (1 << 20);
+    char *buf = malloc(cap);
+    if (!buf)
+    {
+        fprintf(stderr, "Memory allocation failed for %zu bytes\n", cap);
+        exit(1);
+    }
+    size_t len = 0;
+    int functions = 0;
+
+    while (len + LONG_SAY_BYTES + NESTING_DEPTH * NESTING_DEPTH < target_bytes)
+    {
+        len += sprintf(buf + len, "# function %d\nfunction f%d:\n", functions, functions);
+
+        // 一个超长的say字符串
+        len += sprintf(buf + len, "\tsay \"");
+        for (int i = 0; i < LONG_SAY_BYTES; i++)
+            buf[len++] = 'a' + i % 26;
+        len += sprintf(buf + len, "\"\n");
+
+        // 每行比上一行多缩进一层
+        for (int depth = 1; depth <= NESTING_DEPTH; depth++)
+        {
+            memset(buf + len, ' ', depth);
+            len += depth;
+            len += sprintf(buf + len, "say \"depth %d\"\n", depth);
+        }
+        len += sprintf(buf + len, "end\n");
+        functions++;
+    }
+
+    len += sprintf(buf + len, "start:\n");
+    for (int i = 0; i < functions && i < 16; i++)
+        len += sprintf(buf + len, "\tf%d\n", i);
+    len += sprintf(buf + len, "end\n");
+    *out_len = len;
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_mb = argc >= 2 ? strtoul(argv[1], NULL, 10) : 1024;
+    size_t mb = argc >= 3 ? strtoul(argv[2], NULL, 10) : 16;
+
+    StrBuf c_code;
+    strbuf_init(&c_code);
+
+    Arena arena;
+    arena_init(&arena);
+    FlatAST ast;
+    flat_ast_init(&ast);
+
+    int status = 0;
+    double first_ns_per_byte = 0;
+    fprintf(stderr, "%10s %10s %10s %12s\n", "MB", "seconds", "MB/s", "ns/byte");
+    for (; mb <= max_mb && status == 0; mb *= 2)
+    {
+        size_t len;
+        char *source = generate_source(mb << 20, &len);
+
+        double begin = now_seconds();
+        InternTable strings;
+        intern_init(&strings, &arena);
+        Lexer *lexer = new_lexer(source);
+        Parser *parser = new_parser(lexer, &arena, &strings);
+        int node_count;
+        ASTNode **nodes = parse_program(parser, &node_count);
+        if (nodes)
+        {
+            flatten_program(nodes, node_count, &ast);
+            strbuf_reset(&c_code);
+            generate_c_code(NULL, 0, &ast, INCLUDE_USED, 1, &c_code);
+        }
+        double elapsed = now_seconds() - begin;
+
+        free_parser(parser);
+        intern_free(&strings);
+        arena_reset(&arena);
+        free(source);
+
+        if (!nodes)
+        {
+            fprintf(stderr, "%zu MB: parse_program failed\n", mb);
+            status = 1;
+            break;
+        }
+        double ns_per_byte = elapsed * 1e9 / len;
+        fprintf(stderr, "%10.1f %10.3f %10.1f %12.2f\n",
+                len / (1024.0 * 1024.0), elapsed, len / (1024.0 * 1024.0) / elapsed, ns_per_byte);
+        if (first_ns_per_byte == 0)
+            first_ns_per_byte = ns_per_byte;
+        else if (ns_per_byte > first_ns_per_byte * MAX_SLOWDOWN)
+        {
+            fprintf(stderr, "%zu MB: %.2f ns/byte, more than %.1fx the %.2f ns/byte of the smallest input\n", mb,
+                    ns_per_byte, MAX_SLOWDOWN, first_ns_per_byte);
+            status = 1;
+        }
+    }
+    flat_ast_free(&ast);
+    arena_free(&arena);
+    strbuf_free(&c_code);
+    return status;
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+// 一次编译用的内存池：AST节点、名字和字符串都从这里分配，最后整体释放
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaBlock;
+
+typedef struct Arena
+{
+    ArenaBlock *head;  // 当前正在分配的块
+    size_t block_size; // 新块的默认大小
+    size_t total;      // 已分配的字节数（统计用）
+    size_t blocks;     // 向系统申请过的块数（统计用）
+} Arena;
+
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *text, size_t length);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif
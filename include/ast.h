@@ -1,5 +1,6 @@
 #ifndef AST_H
 #define AST_H
+#include "arena.h"
 
 typedef enum
 {
@@ -11,16 +12,18 @@ typedef enum
 typedef struct ASTNode
 {
     NodeType type;
-    char *value; // 对于函数，存储函数名
+    const char *value; // 对于函数，存储函数名（驻留字符串）
 
     // 函数定义的函数体
     struct ASTNode **body;
     int body_count;
+
+    // 函数调用解析到的定义节点
+    struct ASTNode *target;
 } ASTNode;
 
-ASTNode *create_say_node(char *str);
-void free_node(ASTNode *node);
-ASTNode *create_function_call_node(char *name);
-ASTNode *create_function_def_node(char *name, ASTNode **body, int body_count);
-ASTNode *create_block_node(ASTNode **nodes, int count);
+// 节点及其字符串都归arena所有，随arena整体释放
+ASTNode *create_say_node(Arena *arena, const char *str);
+ASTNode *create_function_call_node(Arena *arena, const char *name);
+ASTNode *create_function_def_node(Arena *arena, const char *name, ASTNode **body, int body_count);
 #endif
@@ -0,0 +1,20 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+#include <stdio.h>
+#include "strbuf.h"
+
+// 后端C编译器，生成的C代码从标准输入喂给它（-x c -），不落临时文件
+#define HERCODE_BACKEND_CC "gcc"
+#define HERCODE_BACKEND_OPT "-O2"
+
+// 用posix_spawn启动后端编译器，通过管道写入c_code，等待它结束。prelude不为NULL时用-include预先包含它。
+// 编译器的stderr和这里的错误信息都写到diagnostics（必须是真实的文件，比如stderr或tmpfile()）。
+// 返回编译器的退出码，无法启动或被信号终止时返回-1
+int compile(const StrBuf *c_code, const char *output_name, const char *prelude, FILE *diagnostics);
+// 用和compile相同的选项把header预编译成output_name（通常是header加上.gch），返回值同compile
+int build_precompiled_header(const char *header, const char *output_name, FILE *diagnostics);
+// 后端编译器的版本、目标平台和配置选项（gcc -v的输出），每个进程只运行一次gcc。
+// 无法运行时返回空串
+const char *backend_compiler_identity(void);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "flat_ast.h"
+#include "strbuf.h"
+
+// .hcb字节码文件：文件头、函数表、代码、字符串池依次排列，全部是本机字节序的32位字，
+// 可以直接mmap后执行，不需要任何解析或重定位。文件头里的byte_order按本机字节序写入HCB_BYTE_ORDER，
+// 字节序不同的机器上读出来对不上，整个文件被拒绝。格式变化时增加HCB_VERSION
+#define HCB_MAGIC "HCB\x1a"
+#define HCB_VERSION 2
+#define HCB_BYTE_ORDER 0x01020304u
+
+typedef enum Opcode
+{
+    OP_SAY,  // OP_SAY 字符串偏移 长度：输出字符串池中的一段（已带换行）
+    OP_CALL, // OP_CALL 函数下标
+    OP_TAIL, // OP_TAIL 函数下标：尾调用，复用当前栈帧
+    OP_RET,
+    OP_HALT, // main结束
+    OP_COUNT
+} Opcode;
+
+typedef struct HcbHeader
+{
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t function_count;
+    uint32_t code_words;   // 代码长度，以32位字计
+    uint32_t strings_size; // 字符串池字节数
+    uint32_t entry;        // main在代码中的下标
+} HcbHeader;
+
+typedef struct HcbFunction
+{
+    uint32_t name; // 名字在字符串池中的偏移
+    uint32_t name_length;
+    uint32_t code; // 函数体在代码中的下标
+} HcbFunction;
+
+// 一份已经校验过的字节码，image可能是mmap来的
+typedef struct Bytecode
+{
+    const void *image;
+    size_t size;
+    size_t mapped; // mmap的长度，0表示image由调用者管理
+    const HcbHeader *header;
+    const HcbFunction *functions;
+    const uint32_t *code;
+    const char *strings;
+} Bytecode;
+
+// 把扁平AST编译成完整的.hcb镜像，追加到image末尾。main里的say在这里按C规则解码
+void bytecode_compile(const FlatAST *ast, StrBuf *image);
+// 校验image并建立各部分的视图，不复制；格式、字节序或版本不对时返回-1
+int bytecode_load(Bytecode *bytecode, const void *image, size_t size);
+// mmap一个.hcb文件并校验
+int bytecode_open(Bytecode *bytecode, const char *path);
+void bytecode_close(Bytecode *bytecode);
+// 判断文件开头是不是.hcb的魔数
+int is_bytecode_file(const char *path);
+
+// 用线程化分派执行字节码，输出写到out，成功返回0
+int vm_run(const Bytecode *bytecode, FILE *out, FILE *diagnostics);
+
+#endif
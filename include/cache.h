@@ -0,0 +1,33 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include <stdio.h>
+#include "strbuf.h"
+
+// 按内容寻址的可执行文件缓存：键是生成的C代码、后端编译命令和编译器版本的SHA-256，
+// 命中时直接把缓存里的可执行文件链接（或复制）到输出位置，不再调用gcc。
+typedef struct BuildCache
+{
+    char *dir;     // 缓存目录
+    char key[65];  // 当前程序的键（十六进制）
+    char *entry;   // 缓存项路径 dir/ab/abcdef...
+} BuildCache;
+
+// dir为NULL时依次尝试$HERCODE_CACHE_DIR、$XDG_CACHE_HOME/hercode、$HOME/.cache/hercode。
+// 目录不可用时返回-1，这时应当不用缓存直接编译
+int cache_open(BuildCache *cache, const char *dir);
+void cache_close(BuildCache *cache);
+// 为c_code计算键，之后的fetch/store都针对这个键；prelude是传给compile的预编译头（可以为NULL）
+void cache_set_key(BuildCache *cache, const StrBuf *c_code, const char *prelude);
+// 确保缓存目录里有包含全部标准头文件的预编译头，返回传给compile的头文件路径（调用者free），失败返回NULL
+char *cache_prepare_pch(const BuildCache *cache, FILE *diagnostics);
+// 命中时把可执行文件放到output_name并返回0
+int cache_fetch(const BuildCache *cache, const char *output_name);
+// 把刚编译好的output_name存进缓存，失败不影响编译结果
+void cache_store(const BuildCache *cache, const char *output_name);
+// --run的字节码缓存项路径（调用者free），键是源文件的路径、inode、大小和修改时间，
+// 命中时不需要读源码。源文件不存在时返回NULL
+char *cache_bytecode_entry(const BuildCache *cache, const char *input_name);
+// 先写临时文件再rename，并发的读者只会看到完整的文件
+int cache_store_file(const char *path, const StrBuf *contents);
+
+#endif
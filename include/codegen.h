@@ -1,13 +1,29 @@
 #include "ast.h"
-#include <stdio.h>
-typedef struct
+#include "flat_ast.h"
+#include "strbuf.h"
+
+// 生成代码开头#include哪些标准头文件
+typedef enum IncludeMode
 {
-    char *name;
-    ASTNode **body;
-    int body_count;
-} FunctionDef;
+    INCLUDE_USED, // 只包含程序用到的（默认）
+    INCLUDE_ALL,  // 全部13个，和以前的输出一致
+    INCLUDE_NONE, // 一个都不写，由后端-include的预编译头提供
+} IncludeMode;
+
+// 没有C前导代码的程序在编译期求值，超过这些上限（比如无限递归）就照常生成代码
+#define PRECOMPUTE_MAX_OUTPUT (4 << 20) // 输出字节数
+#define PRECOMPUTE_MAX_DEPTH 10000      // 调用层数
+#define PRECOMPUTE_MAX_CALLS (1 << 20)  // 调用次数
 
-// 最大函数数量
-FunctionDef *find_function(const char *name, FunctionDef **functions, int function_count);
-void generate_c_code(const char *c_header, ASTNode **nodes, int count, FILE *output);
-void compile(char *c_filename, char *output_name);
\ No newline at end of file
+// 生成的C代码追加到output末尾。precompute非0、没有C前导代码且能在上限内求出全部输出时，
+// 生成的main只用write一次写出预先算好的输出
+void generate_c_code(const char *c_header, size_t c_header_length, const FlatAST *ast, IncludeMode includes,
+                     int precompute, StrBuf *output);
+// 写出headers（HEADER_BIT的组合）对应的#include行
+void write_standard_includes(StrBuf *output, unsigned headers);
+// 沿调用图执行start:，把程序的全部输出追加到output，超过上限时output不变并返回-1。
+// 执行前先按调用图静态估算，能走到递归或估算超过上限时直接返回-1
+int precompute_output(const FlatAST *ast, StrBuf *output);
+// main里的say原样放进C字符串字面量，转义序列由C编译器解释，printf("%s")遇到'\0'就停。
+// 不经过C编译器的后端用它得到同样的输出（不含换行）
+void decode_c_literal(const char *text, size_t length, StrBuf *out);
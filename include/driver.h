@@ -0,0 +1,49 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+#include <stdio.h>
+#include "report.h"
+
+// 编译驱动：源文件 -> C代码 -> 缓存/gcc -> 可执行文件
+typedef enum Backend
+{
+    BACKEND_GCC,      // 生成C代码交给gcc
+    BACKEND_NATIVE,   // 直接生成x86-64 ELF
+    BACKEND_BYTECODE, // 生成.hcb字节码，用--run执行
+} Backend;
+
+typedef struct DriverOptions
+{
+    const char *emit_c;    // 额外把生成的C代码保存到这个文件，NULL表示不保存
+    int use_cache;
+    const char *cache_dir; // NULL表示使用默认缓存目录
+    int pch;               // 用缓存目录里的预编译头代替#include
+    Backend backend;
+    int keep_unused;       // 保留start:调用不到的函数
+    int print_removed;     // 把去掉的函数名写到诊断输出
+    int inline_limit;      // 展开不超过这么多条语句的函数，0表示不做内联
+    int precompute;        // 没有C前导代码的程序在编译期算出全部输出
+} DriverOptions;
+
+typedef struct BuildJob
+{
+    const char *input_name;
+    const char *output_name;
+    int status;         // 0表示成功
+    FILE *diagnostics;  // 这个任务的诊断输出（包括gcc的），按输入顺序回放
+    int done;
+} BuildJob;
+
+// 编译一个文件，所有诊断写到diagnostics，成功返回0。
+// report记录各阶段耗时和计数，调用者负责report_init/report_begin和打印
+int build_file(const DriverOptions *options, const char *input_name, const char *output_name,
+               FILE *diagnostics, TimeReport *report);
+
+// --run：执行.hcb文件，或者解析源文件后执行，程序输出写到stdout，成功返回0。
+// 开启缓存时源文件编译成字节码存进缓存目录，源文件没变的话下次直接mmap执行
+int run_file(const DriverOptions *options, const char *input_name, FILE *diagnostics, TimeReport *report);
+
+// 用workers个线程并发编译jobs，同时最多运行max_backends个gcc。
+// 每个任务的诊断和结果按输入顺序输出，返回失败的任务数
+int build_batch(const DriverOptions *options, BuildJob *jobs, int count, int workers, int max_backends);
+
+#endif
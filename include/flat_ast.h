@@ -0,0 +1,37 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+#include <stdint.h>
+#include "ast.h"
+
+// 扁平化的AST：所有节点存放在连续数组里，按"结构体数组"拆成几个并列的数组，
+// 子节点是连续的一段下标 [first_child, first_child + child_count)。
+// 顶层节点占据下标 [0, root_count)，字符串统一放在strings池里，用偏移引用，
+// 因此整个结构不含指针，可以直接序列化。节点的字符串必须是驻留过的，
+// 同一个字符串在池里只存一份。
+typedef struct FlatAST
+{
+    uint8_t *kinds;          // NodeType
+    uint32_t *payload;       // 名字/字符串在strings中的偏移
+    uint32_t *payload_length;
+    uint32_t *first_child;
+    uint32_t *child_count;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t root_count;
+
+    char *strings; // 字符串池，每个字符串后面跟一个'\0'
+    uint32_t strings_size;
+    uint32_t strings_capacity;
+    uint32_t allocations; // 各数组和字符串池realloc的总次数，--time-report用
+} FlatAST;
+
+void flat_ast_init(FlatAST *ast);
+void flat_ast_free(FlatAST *ast);
+void flatten_program(ASTNode **nodes, int count, FlatAST *ast);
+
+static inline const char *flat_ast_string(const FlatAST *ast, uint32_t node)
+{
+    return ast->strings + ast->payload[node];
+}
+
+#endif
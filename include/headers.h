@@ -0,0 +1,34 @@
+#ifndef HEADERS_H
+#define HEADERS_H
+#include <stddef.h>
+
+// 生成代码可能用到的标准头文件，按原来固定输出的顺序排列
+typedef enum StandardHeader
+{
+    HEADER_STDIO,
+    HEADER_STDLIB,
+    HEADER_STRING,
+    HEADER_MATH,
+    HEADER_TIME,
+    HEADER_CTYPE,
+    HEADER_FLOAT,
+    HEADER_ASSERT,
+    HEADER_ERRNO,
+    HEADER_STDDEF,
+    HEADER_SIGNAL,
+    HEADER_SETJMP,
+    HEADER_LOCALE,
+    HEADER_COUNT
+} StandardHeader;
+
+#define HEADER_BIT(header) (1u << (header))
+#define HEADER_ALL ((1u << HEADER_COUNT) - 1)
+
+extern const char *const standard_headers[HEADER_COUNT];
+
+// 扫描C前导代码里的标识符，返回它需要的头文件集合（HEADER_BIT的组合）。
+// 前导代码里声明过的名字算用户自己的；有既不在表里也没声明过的名字时返回HEADER_ALL。
+// 多包含一个头文件无害，所以前缀规则宁宽勿严
+unsigned headers_used_by(const char *c_header, size_t length);
+
+#endif
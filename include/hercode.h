@@ -0,0 +1,29 @@
+#ifndef HERCODE_H
+#define HERCODE_H
+#include <stddef.h>
+
+// libhercode：在内存中把HerCode源码编译成C代码，不读写文件、不启动进程。
+// 每个线程使用自己的HercodeContext即可并发调用；同一个context可以反复使用，
+// 内部的内存池会在多次编译之间复用。
+
+typedef struct HercodeContext HercodeContext;
+
+typedef enum
+{
+    HERCODE_OK = 0,
+    HERCODE_ERROR_SYNTAX,         // 源码有错误，详情见diagnostics
+    HERCODE_ERROR_OUTPUT_TOO_SMALL, // output放不下，*output_length给出需要的字节数（不含'\0'）
+    HERCODE_ERROR_INTERNAL,
+} HercodeStatus;
+
+HercodeContext *hercode_context_new(void);
+void hercode_context_free(HercodeContext *context);
+
+// source不需要以'\0'结尾。生成的C代码写入output并以'\0'结尾，长度写入*output_length。
+// 诊断信息（可以为NULL）会被截断到diagnostics_capacity并以'\0'结尾。
+HercodeStatus hercode_compile_to_c(HercodeContext *context,
+                                   const char *source, size_t source_length,
+                                   char *output, size_t output_capacity, size_t *output_length,
+                                   char *diagnostics, size_t diagnostics_capacity);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef INTERN_H
+#define INTERN_H
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+// 字符串驻留表：每个不同的名字或字符串只在arena里存一份，
+// 相同内容的字符串得到同一个指针，可以直接用指针或ID比较
+typedef struct InternEntry
+{
+    const char *text; // NULL表示空槽
+    uint32_t hash;
+} InternEntry;
+
+typedef struct InternTable
+{
+    Arena *arena; // 字符串的归属
+    InternEntry *entries;
+    uint32_t capacity; // 总是2的幂
+    uint32_t count;    // 同时也是下一个ID
+    uint32_t allocations; // 哈希表分配过几次，--time-report用
+} InternTable;
+
+// 每个驻留字符串前面紧挨着这个头
+typedef struct InternHeader
+{
+    uint32_t id;
+    uint32_t length;
+} InternHeader;
+
+void intern_init(InternTable *table, Arena *arena);
+void intern_free(InternTable *table);
+const char *intern(InternTable *table, const char *text, size_t length);
+// 只查不插：驻留过就返回那个指针，否则返回NULL，表保持不变
+const char *intern_lookup(const InternTable *table, const char *text, size_t length);
+
+// 只能用于intern返回的指针
+static inline uint32_t intern_id(const char *interned)
+{
+    return ((const InternHeader *)interned - 1)->id;
+}
+
+static inline uint32_t intern_length(const char *interned)
+{
+    return ((const InternHeader *)interned - 1)->length;
+}
+
+#endif
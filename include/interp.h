@@ -0,0 +1,13 @@
+#ifndef INTERP_H
+#define INTERP_H
+#include <stdio.h>
+#include "ast.h"
+#include "symtab.h"
+
+// --run：直接执行parse_program返回的顶层节点，不生成C代码也不调用gcc。
+// 函数调用用解析阶段填好的target，没有时再查functions。输出和gcc后端一致
+#define INTERP_MAX_DEPTH (1 << 20) // 调用栈最多这么多层，超过就报错而不是耗尽内存
+
+int run_program(ASTNode **nodes, int count, const SymbolTable *functions, FILE *out, FILE *diagnostics);
+
+#endif
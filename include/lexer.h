@@ -1,5 +1,6 @@
 #ifndef LEXER_H
 #define LEXER_H
+#include <stddef.h>
 
 typedef enum
 {
@@ -18,26 +19,40 @@ typedef enum
     TOKEN_IDENTIFIER // 函数名
 } TokenType;
 
+// Token 不再持有字符串，只记录词素在 Lexer::source 中的位置
 typedef struct Token
 {
     TokenType type;
-    char *value;
+    int start;  // 词素在源码中的起始偏移
+    int length; // 词素长度（字符串字面量不含引号）
 } Token;
 
+// 整个源码预先切分出的连续token数组，以TOKEN_EOF结尾
+typedef struct TokenArray
+{
+    Token *tokens;
+    size_t count;
+    size_t capacity;
+} TokenArray;
+
 typedef struct Lexer
 {
-    char *source;
+    const char *source;
     int pos;
     char current_char;
     int current_indent;    // 当前行的缩进（空格数）
-    int indent_stack[100]; // 缩进级别的栈，用于记录每一层的缩进量
+    int *indent_stack;     // 缩进级别的栈，用于记录每一层的缩进量（按需扩容）
+    int indent_capacity;   // 缩进栈容量
     int indent_top;        // 栈顶指针
     int pending_dedents;   // 待生成的DEDENT数量（当遇到减少缩进时，需要生成多个DEDENT）
 } Lexer;
 
-Lexer *new_lexer(char *source);
+Lexer *new_lexer(const char *source);
 void free_lexer(Lexer *lexer);
-Token *next_token(Lexer *lexer);
-Token *handle_newline_and_indent(Lexer *lexer);
+Token next_token(Lexer *lexer);
+Token handle_newline_and_indent(Lexer *lexer);
+const char *token_text(const Lexer *lexer, Token token);
+void tokenize(Lexer *lexer, TokenArray *array);
+void free_token_array(TokenArray *array);
 
 #endif
\ No newline at end of file
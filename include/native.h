@@ -0,0 +1,11 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+#include "flat_ast.h"
+#include "strbuf.h"
+
+// --backend=native：不经过C编译器，直接把扁平AST翻译成x86-64 Linux的静态ELF可执行文件。
+// 每个say是一次write系统调用，函数调用就是call/ret，字符串放在只读数据区。
+// 只能处理没有C前导代码的程序。生成的文件内容追加到output，成功返回0
+int emit_native_executable(const FlatAST *ast, StrBuf *output);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+#include <stddef.h>
+#include "ast.h"
+#include "symtab.h"
+#include "intern.h"
+#include "arena.h"
+
+#define INLINE_DEFAULT_LIMIT 8 // 展开后不超过这么多条语句的函数在每个调用处展开
+
+// 在parse_program返回的顶层节点上做的优化，在扁平化和各个后端之前进行
+
+// 从start:里的语句出发沿调用图标记能到达的函数，把其余函数定义从顶层节点中去掉，
+// nodes原地压缩，返回剩下的节点数。C前导代码写在main里，其中出现function_<名字>的函数也算可达。
+// removed不为NULL时依次存入被去掉的函数定义节点，它要能放下count个
+int remove_unreachable_functions(ASTNode **nodes, int count, const SymbolTable *functions,
+                                 const InternTable *strings, const char *c_header, size_t c_header_length,
+                                 ASTNode **removed, int *removed_count);
+
+// 把不超过max_statements条语句的函数和只有一处调用的函数直接展开到调用处，
+// 被调用的函数先处理，所以展开是传递的。递归和互相递归的函数不展开，但它们里面的调用照常展开。
+// 函数里的say按原样输出而main里的会解释C转义，含反斜杠的函数不展开到main里。
+// 改过的函数体和新的顶层节点数组都放在arena里，返回新的顶层节点数组，*count更新为新的节点数
+ASTNode **inline_functions(ASTNode **nodes, int *count, const SymbolTable *functions, Arena *arena,
+                           int max_statements, int *inlined_calls);
+
+#endif
@@ -1,20 +1,37 @@
+#include <setjmp.h>
+#include <stdio.h>
 #include "ast.h"
 #include "lexer.h"
+#include "symtab.h"
+#include "intern.h"
 
 // parser.h
 typedef struct Parser
 {
     Lexer *lexer;
-    Token *current_token;
-    int current_indent; // 当前缩进级别
+    Arena *arena;         // AST的归属
+    InternTable *strings; // 名字和字符串字面量的驻留表
+    ASTNode **scratch;    // 解析块时暂存子节点的栈
+    int scratch_count;
+    int scratch_capacity;
+    SymbolTable functions; // 顶层函数定义
+    ASTNode **calls;       // 所有函数调用节点，解析结束后统一解析
+    int call_count;
+    int call_capacity;
+    int error_count;
+    FILE *diagnostics;    // 错误信息写到这里，默认stderr
+    jmp_buf on_error;     // 语法错误时跳回parse_program
+    TokenArray tokens;    // 预先切分好的全部token
+    Token *current_token; // 指向tokens中的当前位置
+    int current_indent;   // 当前缩进级别
 } Parser;
 
-Parser *new_parser(Lexer *lexer);
+const char *token_type_to_string(TokenType type);
+Parser *new_parser(Lexer *lexer, Arena *arena, InternTable *strings);
 void free_parser(Parser *parser);
-void free_token(Token *token);
-void free_token(Token *token);
+Token *peek_token(Parser *parser, int n);
 ASTNode *parse_statement(Parser *parser);
-ASTNode *parse_block(Parser *parser, int *count);
+// 出错时把诊断信息写到parser->diagnostics并返回NULL
 ASTNode **parse_program(Parser *parser, int *count);
 ASTNode *parse_say_statement(Parser *parser);
 ASTNode *parse_function_definition(Parser *parser);
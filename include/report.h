@@ -0,0 +1,41 @@
+#ifndef REPORT_H
+#define REPORT_H
+#include <stdio.h>
+
+// --time-report：记录每个阶段的墙钟时间和CPU时间，以及各子系统的计数
+#define REPORT_MAX_PHASES 16
+#define REPORT_MAX_COUNTERS 32
+
+typedef struct ReportPhase
+{
+    const char *name;
+    double wall; // 秒
+    double cpu;  // 秒，包括这个阶段里等待的子进程（gcc）
+} ReportPhase;
+
+typedef struct ReportCounter
+{
+    const char *name;
+    long long value;
+} ReportCounter;
+
+typedef struct TimeReport
+{
+    ReportPhase phases[REPORT_MAX_PHASES];
+    int phase_count;
+    ReportCounter counters[REPORT_MAX_COUNTERS];
+    int counter_count;
+
+    // 当前阶段开始时的时间点
+    double wall_start;
+    double cpu_start;
+} TimeReport;
+
+void report_init(TimeReport *report);
+void report_begin(TimeReport *report);
+void report_end(TimeReport *report, const char *phase);
+void report_count(TimeReport *report, const char *name, long long value);
+// json为0时输出人类可读的表格
+void report_print(const TimeReport *report, FILE *out, int json);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+// 词法分析用的快速扫描函数
+// 在以'\0'结尾的缓冲区中查找第一个等于a或b的字节，找不到时返回指向'\0'的指针
+const char *scan_until(const char *p, char a, char b);
+// 跳过空格、制表符和'\r'（不跳过'\n'，换行对缩进有意义）
+const char *skip_blanks(const char *p);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SHA256_H
+#define SHA256_H
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Sha256
+{
+    uint32_t state[8];
+    uint64_t bytes; // 已输入的总字节数
+    uint8_t block[64];
+    size_t block_used;
+} Sha256;
+
+void sha256_init(Sha256 *hash);
+void sha256_update(Sha256 *hash, const void *data, size_t length);
+void sha256_final(Sha256 *hash, uint8_t digest[32]);
+
+#endif
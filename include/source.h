@@ -0,0 +1,21 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+#include <stddef.h>
+
+// 只读映射的源文件，data总是以'\0'结尾，词法分析器可以直接在上面工作
+typedef struct SourceFile
+{
+    const char *data;
+    size_t size;   // 文件字节数（不含结尾的'\0'）
+    size_t mapped; // 映射长度，0表示data是读入的堆内存
+} SourceFile;
+
+int open_source_file(const char *filename, SourceFile *file);
+void close_source_file(SourceFile *file);
+
+// 在行首查找magic_string，把源码切成C头和HerCode两段视图，不复制任何字节
+void separate_header(const char *source, size_t size, const char *magic_string,
+                     const char **c_header, size_t *c_header_length,
+                     const char **hercode_source);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+#include <stddef.h>
+#include <string.h>
+
+// 可增长的内存输出缓冲区，代码生成先写到这里，再一次性交给文件或后端编译器。
+// data总是以'\0'结尾（length不含它）。
+typedef struct StrBuf
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t allocations; // realloc的次数，--time-report用
+} StrBuf;
+
+void strbuf_init(StrBuf *buffer);
+void strbuf_free(StrBuf *buffer);
+void strbuf_reset(StrBuf *buffer); // 清空内容，保留已分配的内存
+void strbuf_reserve(StrBuf *buffer, size_t extra);
+void strbuf_printf(StrBuf *buffer, const char *format, ...) __attribute__((format(printf, 2, 3)));
+// 把整个缓冲区写到文件描述符，成功返回0
+int strbuf_write_fd(const StrBuf *buffer, int fd);
+// 用一次write把缓冲区写成文件，mode是新建文件的权限（受umask影响），成功返回0
+int strbuf_write_file(const StrBuf *buffer, const char *path, int mode);
+
+static inline void strbuf_append(StrBuf *buffer, const char *data, size_t length)
+{
+    strbuf_reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static inline void strbuf_puts(StrBuf *buffer, const char *text)
+{
+    strbuf_append(buffer, text, strlen(text));
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+#include <stdint.h>
+#include "ast.h"
+#include "intern.h"
+
+// 函数符号表：开放定址（线性探测）哈希表，键是驻留过的函数名，按指针比较
+typedef struct FunctionDef
+{
+    const char *name; // NULL表示空槽
+    uint32_t hash;
+    ASTNode *node; // 函数定义节点
+} FunctionDef;
+
+typedef struct SymbolTable
+{
+    FunctionDef *entries;
+    uint32_t capacity; // 总是2的幂
+    uint32_t count;
+    uint32_t allocations; // 哈希表分配过几次，--time-report用
+} SymbolTable;
+
+void symtab_init(SymbolTable *table);
+void symtab_free(SymbolTable *table);
+// 插入函数定义；同名函数已存在时不覆盖，直接返回已有的表项
+FunctionDef *symtab_insert(SymbolTable *table, const char *name, ASTNode *node);
+FunctionDef *find_function(const SymbolTable *table, const char *name);
+
+#endif
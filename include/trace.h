@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// 分级的调试跟踪输出（--trace=lexer,parser,driver）。
+// 定义了HERCODE_TRACE时编译进来，未开启的类别只多一次可预测的分支；
+// 未定义时（Release构建）TRACE整个展开为空。
+typedef enum
+{
+    TRACE_LEXER = 1 << 0,
+    TRACE_PARSER = 1 << 1,
+    TRACE_DRIVER = 1 << 2,
+    TRACE_ALL = TRACE_LEXER | TRACE_PARSER | TRACE_DRIVER,
+} TraceCategory;
+
+extern unsigned trace_mask;
+
+// 解析逗号分隔的类别列表并打开它们，遇到未知类别返回-1
+int trace_enable(const char *categories);
+void trace_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#ifdef HERCODE_TRACE
+#define TRACE(category, ...)                               \
+    do                                                     \
+    {                                                      \
+        if (__builtin_expect(trace_mask & (category), 0))  \
+            trace_printf(__VA_ARGS__);                     \
+    } while (0)
+#else
+#define TRACE(category, ...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN sizeof(void *)
+
+void arena_init(Arena *arena)
+{
+    arena->head = NULL;
+    arena->block_size = ARENA_BLOCK_SIZE;
+    arena->total = 0;
+    arena->blocks = 0;
+}
+
+static ArenaBlock *new_block(Arena *arena, size_t capacity, ArenaBlock *next)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (!block)
+    {
+        fprintf(stderr, "Memory allocation failed for arena block\n");
+        exit(1);
+    }
+    block->next = next;
+    block->used = 0;
+    block->capacity = capacity;
+    arena->blocks++;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    ArenaBlock *block = arena->head;
+    if (!block || block->capacity - block->used < size)
+    {
+        // 超大的分配单独占一个块，挂在当前块后面，不浪费当前块的剩余空间
+        if (size > arena->block_size / 4 && block)
+        {
+            ArenaBlock *big = new_block(arena, size, block->next);
+            block->next = big;
+            big->used = size;
+            arena->total += size;
+            return big->data;
+        }
+        block = new_block(arena, size > arena->block_size ? size : arena->block_size, block);
+        arena->head = block;
+    }
+    void *result = block->data + block->used;
+    block->used += size;
+    arena->total += size;
+    return result;
+}
+
+char *arena_strndup(Arena *arena, const char *text, size_t length)
+{
+    char *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// 释放除最新一块以外的所有块，保留一块供下次编译复用
+void arena_reset(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    if (!block)
+        return;
+    ArenaBlock *rest = block->next;
+    while (rest)
+    {
+        ArenaBlock *next = rest->next;
+        free(rest);
+        rest = next;
+    }
+    block->next = NULL;
+    block->used = 0;
+    arena->total = 0;
+    arena->blocks = 1; // 只剩保留下来的这一块
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->total = 0;
+}
@@ -1,70 +1,43 @@
 #include "ast.h"
-#include <stdlib.h>
 #include <string.h>
 
-ASTNode *create_say_node(char *str)
+// 所有节点都从编译用的arena分配，字符串由调用者事先驻留，这里不再复制
+
+static ASTNode *new_node(Arena *arena, NodeType type, const char *value)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = STMT_SAY;
-    node->value = strdup(str);
+    ASTNode *node = arena_alloc(arena, sizeof(ASTNode));
+    node->type = type;
+    node->value = value;
+    node->body = NULL;
+    node->body_count = 0;
+    node->target = NULL;
     return node;
 }
 
-ASTNode *create_function_def_node(char *name, ASTNode **body, int body_count)
+// 把临时数组里的子节点复制到arena中
+static ASTNode **copy_body(Arena *arena, ASTNode **body, int body_count)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = STMT_FUNCTION_DEF;
-    node->value = strdup(name);
-    node->body = malloc(sizeof(ASTNode *) * body_count);
-    node->body_count = body_count;
-
-    for (int i = 0; i < body_count; i++)
-    {
-        node->body[i] = body[i];
-    }
-
-    return node;
+    if (body_count == 0)
+        return NULL;
+    ASTNode **copy = arena_alloc(arena, sizeof(ASTNode *) * body_count);
+    memcpy(copy, body, sizeof(ASTNode *) * body_count);
+    return copy;
 }
 
-ASTNode *create_function_call_node(char *name)
+ASTNode *create_say_node(Arena *arena, const char *str)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = STMT_FUNCTION_CALL;
-    node->value = strdup(name);
-    node->body = NULL;
-    node->body_count = 0;
-    return node;
+    return new_node(arena, STMT_SAY, str);
 }
 
-void free_node(ASTNode *node)
+ASTNode *create_function_def_node(Arena *arena, const char *name, ASTNode **body, int body_count)
 {
-    if (node)
-    {
-        free(node->value);
-        free(node);
-    }
+    ASTNode *node = new_node(arena, STMT_FUNCTION_DEF, name);
+    node->body = copy_body(arena, body, body_count);
+    node->body_count = body_count;
+    return node;
 }
 
-ASTNode *create_block_node(ASTNode **nodes, int count)
+ASTNode *create_function_call_node(Arena *arena, const char *name)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    if (!node)
-        return NULL;
-
-    node->type = STMT_SAY; // 暂时使用SAY类型
-    node->value = NULL;
-    node->body = malloc(sizeof(ASTNode *) * count);
-    if (!node->body)
-    {
-        free(node);
-        return NULL;
-    }
-
-    node->body_count = count;
-    for (int i = 0; i < count; i++)
-    {
-        node->body[i] = nodes[i];
-    }
-
-    return node;
+    return new_node(arena, STMT_FUNCTION_CALL, name);
 }
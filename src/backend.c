@@ -0,0 +1,178 @@
+#define _GNU_SOURCE // pipe2
+#include "backend.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// 编译器提前退出时写管道会收到SIGPIPE。只在当前线程里屏蔽它，
+// 写完后把可能挂起的SIGPIPE取走，不影响宿主程序自己的信号处理
+static int write_to_pipe(const StrBuf *c_code, int fd)
+{
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    int result = strbuf_write_fd(c_code, fd);
+    if (result != 0 && errno == EPIPE && !sigismember(&old_set, SIGPIPE))
+    {
+        struct timespec zero = {0, 0};
+        while (sigtimedwait(&pipe_set, NULL, &zero) < 0 && errno == EINTR)
+            ;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    return result;
+}
+
+// 启动编译器并等待它结束。input不为NULL时通过管道写到编译器的标准输入
+static int run_compiler(char *argv[], const StrBuf *input, FILE *diagnostics)
+{
+    int fds[2] = {-1, -1};
+    // 两端创建时就带上O_CLOEXEC：批量编译时别的线程随时可能spawn，
+    // 写端漏进别的gcc会让这个gcc迟迟读不到EOF
+    if (input && pipe2(fds, O_CLOEXEC) != 0)
+    {
+        fprintf(diagnostics, "pipe: %s\n", strerror(errno));
+        return -1;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (input)
+    {
+        posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+        posix_spawn_file_actions_addclose(&actions, fds[0]);
+    }
+    // 编译器直接写进diagnostics背后的文件，之前缓冲的内容要先落盘才能保持顺序
+    fflush(diagnostics);
+    int diagnostics_fd = fileno(diagnostics);
+    if (diagnostics_fd >= 0 && diagnostics_fd != STDERR_FILENO)
+        posix_spawn_file_actions_adddup2(&actions, diagnostics_fd, STDERR_FILENO);
+
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (input)
+        close(fds[0]);
+    if (error != 0)
+    {
+        fprintf(diagnostics, "Failed to start %s: %s\n", argv[0], strerror(error));
+        if (input)
+            close(fds[1]);
+        return -1;
+    }
+
+    if (input)
+    {
+        if (write_to_pipe(input, fds[1]) != 0 && errno != EPIPE)
+            fprintf(diagnostics, "Error writing to compiler: %s\n", strerror(errno));
+        close(fds[1]);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            fprintf(diagnostics, "waitpid: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    // 编译器写入后文件末尾变了，后面的诊断接着写在它后面
+    if (diagnostics_fd != STDERR_FILENO)
+        fseek(diagnostics, 0, SEEK_END);
+    if (!WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+int compile(const StrBuf *c_code, const char *output_name, const char *prelude, FILE *diagnostics)
+{
+    char *argv[10];
+    int argc = 0;
+    argv[argc++] = HERCODE_BACKEND_CC;
+    argv[argc++] = HERCODE_BACKEND_OPT;
+    argv[argc++] = "-o";
+    argv[argc++] = (char *)output_name;
+    if (prelude)
+    {
+        // prelude旁边有.gch时gcc会直接加载预编译结果
+        argv[argc++] = "-include";
+        argv[argc++] = (char *)prelude;
+    }
+    argv[argc++] = "-x";
+    argv[argc++] = "c";
+    argv[argc++] = "-";
+    argv[argc] = NULL;
+    return run_compiler(argv, c_code, diagnostics);
+}
+
+int build_precompiled_header(const char *header, const char *output_name, FILE *diagnostics)
+{
+    char *argv[] = {HERCODE_BACKEND_CC, HERCODE_BACKEND_OPT, "-x", "c-header", (char *)header, "-o", (char *)output_name, NULL};
+    return run_compiler(argv, NULL, diagnostics);
+}
+
+static char compiler_identity[4096];
+static pthread_once_t compiler_identity_once = PTHREAD_ONCE_INIT;
+
+// 运行gcc -v，把它写到stderr的目标平台、配置选项和带发行版修订号的版本读进compiler_identity。
+// -dumpfullversion和-dumpmachine一次只会输出一个，-v一次就能拿到全部
+static void read_compiler_identity(void)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+        return;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+    char *argv[] = {HERCODE_BACKEND_CC, "-v", NULL};
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+
+    // 放不下的部分也要读走，免得编译器写满管道后一直等着
+    size_t length = 0;
+    char chunk[256];
+    ssize_t n;
+    while ((n = read(fds[0], chunk, sizeof(chunk))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        size_t copy = sizeof(compiler_identity) - 1 - length;
+        if ((size_t)n < copy)
+            copy = n;
+        memcpy(compiler_identity + length, chunk, copy);
+        length += copy;
+    }
+    close(fds[0]);
+    compiler_identity[length] = '\0';
+    if (error == 0)
+    {
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            ;
+    }
+}
+
+const char *backend_compiler_identity(void)
+{
+    pthread_once(&compiler_identity_once, read_compiler_identity);
+    return compiler_identity;
+}
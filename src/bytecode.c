@@ -0,0 +1,288 @@
+#include "bytecode.h"
+#include "codegen.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct FunctionSlot
+{
+    uint32_t name; // 名字在FlatAST字符串池中的偏移，驻留过的名字偏移相同
+    uint32_t index;
+} FunctionSlot;
+
+static int compare_slot(const void *a, const void *b)
+{
+    uint32_t x = ((const FunctionSlot *)a)->name, y = ((const FunctionSlot *)b)->name;
+    return (x > y) - (x < y);
+}
+
+static void put_word(StrBuf *code, uint32_t word)
+{
+    strbuf_append(code, (const char *)&word, sizeof(word));
+}
+
+typedef struct BytecodeWriter
+{
+    const FlatAST *ast;
+    FunctionSlot *slots;
+    uint32_t function_count;
+    StrBuf code;
+    StrBuf extra; // main里解码过的字符串，接在FlatAST字符串池后面
+} BytecodeWriter;
+
+static uint32_t function_index(const BytecodeWriter *writer, uint32_t name)
+{
+    FunctionSlot key = {name, 0};
+    const FunctionSlot *found = bsearch(&key, writer->slots, writer->function_count, sizeof(FunctionSlot), compare_slot);
+    // 语法分析已经保证调用的函数都存在
+    return found ? found->index : 0;
+}
+
+static void compile_statement(BytecodeWriter *writer, uint32_t node, int in_main, int tail)
+{
+    const FlatAST *ast = writer->ast;
+    if (ast->kinds[node] == STMT_FUNCTION_CALL)
+    {
+        put_word(&writer->code, tail ? OP_TAIL : OP_CALL);
+        put_word(&writer->code, function_index(writer, ast->payload[node]));
+        return;
+    }
+    if (ast->kinds[node] != STMT_SAY)
+        return;
+
+    const char *text = flat_ast_string(ast, node);
+    uint32_t length = ast->payload_length[node];
+    put_word(&writer->code, OP_SAY);
+    if (in_main && memchr(text, '\\', length))
+    {
+        uint32_t start = (uint32_t)writer->extra.length;
+        decode_c_literal(text, length, &writer->extra);
+        strbuf_append(&writer->extra, "\n", 1);
+        put_word(&writer->code, ast->strings_size + start);
+        put_word(&writer->code, (uint32_t)writer->extra.length - start);
+        return;
+    }
+    // 池里每个字符串后面的'\0'在镜像中换成了'\n'，字符串和换行正好连在一起
+    put_word(&writer->code, ast->payload[node]);
+    put_word(&writer->code, length + 1);
+}
+
+void bytecode_compile(const FlatAST *ast, StrBuf *image)
+{
+    BytecodeWriter writer;
+    writer.ast = ast;
+    writer.slots = malloc((ast->root_count ? ast->root_count : 1) * sizeof(FunctionSlot));
+    if (!writer.slots)
+    {
+        fprintf(stderr, "Memory allocation failed for bytecode\n");
+        exit(1);
+    }
+    writer.function_count = 0;
+    strbuf_init(&writer.code);
+    strbuf_init(&writer.extra);
+
+    HcbFunction *functions = malloc((ast->root_count ? ast->root_count : 1) * sizeof(HcbFunction));
+    if (!functions)
+    {
+        fprintf(stderr, "Memory allocation failed for bytecode\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            continue;
+        functions[writer.function_count].name = ast->payload[i];
+        functions[writer.function_count].name_length = ast->payload_length[i];
+        writer.slots[writer.function_count].name = ast->payload[i];
+        writer.slots[writer.function_count].index = writer.function_count;
+        writer.function_count++;
+    }
+    qsort(writer.slots, writer.function_count, sizeof(FunctionSlot), compare_slot);
+
+    // main在最前面，以OP_HALT结束
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            compile_statement(&writer, i, 1, 0);
+    }
+    put_word(&writer.code, OP_HALT);
+
+    // 函数体最后一条是调用时编成尾调用，不再需要OP_RET
+    uint32_t function = 0;
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            continue;
+        functions[function++].code = (uint32_t)(writer.code.length / sizeof(uint32_t));
+        uint32_t end = ast->first_child[i] + ast->child_count[i];
+        int tail = 0;
+        for (uint32_t stmt = ast->first_child[i]; stmt < end; stmt++)
+        {
+            tail = stmt + 1 == end && ast->kinds[stmt] == STMT_FUNCTION_CALL;
+            compile_statement(&writer, stmt, 0, tail);
+        }
+        if (!tail)
+            put_word(&writer.code, OP_RET);
+    }
+
+    HcbHeader header;
+    memcpy(header.magic, HCB_MAGIC, 4);
+    header.byte_order = HCB_BYTE_ORDER;
+    header.version = HCB_VERSION;
+    header.function_count = writer.function_count;
+    header.code_words = (uint32_t)(writer.code.length / sizeof(uint32_t));
+    header.strings_size = ast->strings_size + (uint32_t)writer.extra.length;
+    header.entry = 0;
+
+    strbuf_append(image, (const char *)&header, sizeof(header));
+    strbuf_append(image, (const char *)functions, writer.function_count * sizeof(HcbFunction));
+    strbuf_append(image, writer.code.data, writer.code.length);
+    size_t pool_start = image->length;
+    if (ast->strings_size > 0)
+        strbuf_append(image, ast->strings, ast->strings_size);
+    for (size_t i = pool_start; i < image->length; i++)
+    {
+        if (image->data[i] == '\0')
+            image->data[i] = '\n';
+    }
+    if (writer.extra.length > 0)
+        strbuf_append(image, writer.extra.data, writer.extra.length);
+
+    free(functions);
+    free(writer.slots);
+    strbuf_free(&writer.code);
+    strbuf_free(&writer.extra);
+}
+
+// 检查每条指令的操作码和操作数，以及所有入口都落在指令开头，之后执行时不再做任何边界检查
+static int verify_code(const Bytecode *bytecode)
+{
+    const HcbHeader *header = bytecode->header;
+    const uint32_t *code = bytecode->code;
+    uint32_t words = header->code_words;
+    if (words == 0)
+        return -1;
+    uint8_t *starts = calloc(words, 1);
+    if (!starts)
+        return -1;
+
+    int result = 0;
+    uint32_t last = 0;
+    for (uint32_t pc = 0; pc < words && result == 0;)
+    {
+        starts[pc] = 1;
+        last = code[pc];
+        switch (code[pc])
+        {
+        case OP_SAY:
+            if (words - pc < 3 || code[pc + 1] > header->strings_size ||
+                code[pc + 2] > header->strings_size - code[pc + 1])
+                result = -1;
+            pc += 3;
+            break;
+        case OP_CALL:
+        case OP_TAIL:
+            if (words - pc < 2 || code[pc + 1] >= header->function_count)
+                result = -1;
+            pc += 2;
+            break;
+        case OP_RET:
+        case OP_HALT:
+            pc++;
+            break;
+        default:
+            result = -1;
+            break;
+        }
+    }
+    // 最后一条必须是控制转移，执行不会越过代码末尾
+    if (last != OP_RET && last != OP_HALT && last != OP_TAIL)
+        result = -1;
+    if (header->entry >= words || !starts[header->entry])
+        result = -1;
+    for (uint32_t i = 0; i < header->function_count && result == 0; i++)
+    {
+        const HcbFunction *function = &bytecode->functions[i];
+        if (function->code >= words || !starts[function->code] || function->name > header->strings_size ||
+            function->name_length > header->strings_size - function->name)
+            result = -1;
+    }
+    free(starts);
+    return result;
+}
+
+int bytecode_load(Bytecode *bytecode, const void *image, size_t size)
+{
+    memset(bytecode, 0, sizeof(Bytecode));
+    if (size < sizeof(HcbHeader))
+        return -1;
+    const HcbHeader *header = image;
+    if (memcmp(header->magic, HCB_MAGIC, 4) != 0 || header->byte_order != HCB_BYTE_ORDER ||
+        header->version != HCB_VERSION)
+        return -1;
+    uint64_t expected = sizeof(HcbHeader) + (uint64_t)header->function_count * sizeof(HcbFunction) +
+                        (uint64_t)header->code_words * sizeof(uint32_t) + header->strings_size;
+    if (expected != size)
+        return -1;
+
+    bytecode->image = image;
+    bytecode->size = size;
+    bytecode->header = header;
+    bytecode->functions = (const HcbFunction *)(header + 1);
+    bytecode->code = (const uint32_t *)(bytecode->functions + header->function_count);
+    bytecode->strings = (const char *)(bytecode->code + header->code_words);
+    return verify_code(bytecode);
+}
+
+int bytecode_open(Bytecode *bytecode, const char *path)
+{
+    memset(bytecode, 0, sizeof(Bytecode));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(HcbHeader))
+    {
+        close(fd);
+        return -1;
+    }
+    void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+        return -1;
+    if (bytecode_load(bytecode, image, st.st_size) != 0)
+    {
+        munmap(image, st.st_size);
+        return -1;
+    }
+    bytecode->mapped = st.st_size;
+    return 0;
+}
+
+void bytecode_close(Bytecode *bytecode)
+{
+    if (bytecode->mapped)
+        munmap((void *)bytecode->image, bytecode->mapped);
+    memset(bytecode, 0, sizeof(Bytecode));
+}
+
+int is_bytecode_file(const char *path)
+{
+    char magic[4];
+    // 管道之类只能读一次，读走开头就没法再当源码解析，只看普通文件
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return 0;
+    }
+    ssize_t n = read(fd, magic, sizeof(magic));
+    close(fd);
+    return n == sizeof(magic) && memcmp(magic, HCB_MAGIC, 4) == 0;
+}
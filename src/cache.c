@@ -0,0 +1,301 @@
+#include "cache.h"
+#include "backend.h"
+#include "sha256.h"
+#include "codegen.h"
+#include "headers.h"
+#include "bytecode.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 逐级创建目录，相当于mkdir -p
+static int make_dirs(char *path)
+{
+    for (char *p = path + 1; *p; p++)
+    {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        int result = mkdir(path, 0755);
+        *p = '/';
+        if (result != 0 && errno != EEXIST)
+            return -1;
+    }
+    if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        return -1;
+    return 0;
+}
+
+static char *join_path(const char *a, const char *b)
+{
+    size_t length = strlen(a) + strlen(b) + 2;
+    char *path = malloc(length);
+    if (!path)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    snprintf(path, length, "%s/%s", a, b);
+    return path;
+}
+
+int cache_open(BuildCache *cache, const char *dir)
+{
+    cache->entry = NULL;
+    cache->key[0] = '\0';
+    if (dir)
+        cache->dir = strdup(dir);
+    else if ((dir = getenv("HERCODE_CACHE_DIR")) && *dir)
+        cache->dir = strdup(dir);
+    else if ((dir = getenv("XDG_CACHE_HOME")) && *dir)
+        cache->dir = join_path(dir, "hercode");
+    else if ((dir = getenv("HOME")) && *dir)
+        cache->dir = join_path(dir, ".cache/hercode");
+    else
+        cache->dir = NULL;
+    if (!cache->dir || make_dirs(cache->dir) != 0)
+    {
+        free(cache->dir);
+        cache->dir = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void cache_close(BuildCache *cache)
+{
+    free(cache->dir);
+    free(cache->entry);
+    cache->dir = NULL;
+    cache->entry = NULL;
+}
+
+// 编译器的身份：gcc报告的版本和目标平台，加上在PATH里找到的实际路径、大小和修改时间。
+// 升级时驱动程序本身可能不变（只换了cc1），所以版本号也要算进去；它每个进程只查询一次
+static void hash_compiler(Sha256 *hash)
+{
+    const char *identity = backend_compiler_identity();
+    sha256_update(hash, identity, strlen(identity) + 1);
+    const char *path_env = getenv("PATH");
+    if (!path_env)
+        path_env = "/usr/bin:/bin";
+    char candidate[PATH_MAX];
+    const char *p = path_env;
+    while (*p)
+    {
+        const char *end = strchr(p, ':');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)length, length ? p : ".", HERCODE_BACKEND_CC);
+        struct stat st;
+        char resolved[PATH_MAX];
+        if (access(candidate, X_OK) == 0 && stat(candidate, &st) == 0 && realpath(candidate, resolved))
+        {
+            sha256_update(hash, resolved, strlen(resolved) + 1);
+            long long identity[3] = {(long long)st.st_size, (long long)st.st_mtim.tv_sec, (long long)st.st_mtim.tv_nsec};
+            sha256_update(hash, identity, sizeof(identity));
+            return;
+        }
+        p += length;
+        if (*p == ':')
+            p++;
+    }
+}
+
+// 同目录下的临时文件名，进程号加计数器，批量编译时各线程之间也不会重名
+static char *temp_name(const char *path)
+{
+    static atomic_uint counter;
+    char *temp = malloc(strlen(path) + 48);
+    if (!temp)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sprintf(temp, "%s.tmp%ld.%u", path, (long)getpid(), atomic_fetch_add(&counter, 1));
+    return temp;
+}
+
+char *cache_prepare_pch(const BuildCache *cache, FILE *diagnostics)
+{
+    // 目录名取编译器身份的哈希，换了gcc自然会用新的目录重新生成
+    static const char command[] = HERCODE_BACKEND_CC " " HERCODE_BACKEND_OPT " -x c-header";
+    Sha256 hash;
+    sha256_init(&hash);
+    sha256_update(&hash, command, sizeof(command));
+    hash_compiler(&hash);
+    uint8_t digest[32];
+    sha256_final(&hash, digest);
+    char name[32] = "pch-";
+    for (int i = 0; i < 8; i++)
+        snprintf(name + 4 + i * 2, 3, "%02x", digest[i]);
+
+    char *pch_dir = join_path(cache->dir, name);
+    mkdir(pch_dir, 0755);
+    char *header = join_path(pch_dir, "hercode_prelude.h");
+    char *gch = malloc(strlen(header) + 5);
+    if (!gch)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sprintf(gch, "%s.gch", header);
+    free(pch_dir);
+
+    int ok = access(gch, R_OK) == 0;
+    if (!ok)
+    {
+        // 头文件和.gch都先写到临时名再rename，并发的任务只会看到完整的文件
+        StrBuf text;
+        strbuf_init(&text);
+        write_standard_includes(&text, HEADER_ALL);
+        char *temp_header = temp_name(header);
+        char *temp_gch = temp_name(gch);
+        ok = strbuf_write_file(&text, temp_header, 0666) == 0 && rename(temp_header, header) == 0 &&
+             build_precompiled_header(header, temp_gch, diagnostics) == 0 && rename(temp_gch, gch) == 0;
+        unlink(temp_header);
+        unlink(temp_gch);
+        free(temp_header);
+        free(temp_gch);
+        strbuf_free(&text);
+    }
+    free(gch);
+    if (!ok)
+    {
+        free(header);
+        return NULL;
+    }
+    return header;
+}
+
+void cache_set_key(BuildCache *cache, const StrBuf *c_code, const char *prelude)
+{
+    static const char command[] = HERCODE_BACKEND_CC " " HERCODE_BACKEND_OPT " -x c -";
+    Sha256 hash;
+    sha256_init(&hash);
+    sha256_update(&hash, command, sizeof(command));
+    // 预编译头的路径里已经带着编译器身份，内容固定
+    if (prelude)
+        sha256_update(&hash, prelude, strlen(prelude) + 1);
+    hash_compiler(&hash);
+    sha256_update(&hash, c_code->data, c_code->length);
+    uint8_t digest[32];
+    sha256_final(&hash, digest);
+    for (int i = 0; i < 32; i++)
+        snprintf(cache->key + i * 2, 3, "%02x", digest[i]);
+
+    // 按前两位分子目录，避免单个目录里文件过多
+    char shard[3] = {cache->key[0], cache->key[1], '\0'};
+    char *shard_dir = join_path(cache->dir, shard);
+    mkdir(shard_dir, 0755);
+    free(cache->entry);
+    cache->entry = join_path(shard_dir, cache->key);
+    free(shard_dir);
+}
+
+static int copy_file(const char *from, const char *to)
+{
+    int in = open(from, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return -1;
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+    if (out < 0)
+    {
+        close(in);
+        return -1;
+    }
+    char buffer[65536];
+    ssize_t n;
+    int result = 0;
+    while ((n = read(in, buffer, sizeof(buffer))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            result = -1;
+            break;
+        }
+        StrBuf chunk = {buffer, (size_t)n, sizeof(buffer)};
+        if (strbuf_write_fd(&chunk, out) != 0)
+        {
+            result = -1;
+            break;
+        }
+    }
+    close(in);
+    if (close(out) != 0)
+        result = -1;
+    return result;
+}
+
+// 先链接或复制到同目录的临时名，再rename过去，别的进程不会看到写了一半的文件
+static int install_file(const char *from, const char *to)
+{
+    char *temp = temp_name(to);
+    unlink(temp);
+    int result = link(from, temp) == 0 || copy_file(from, temp) == 0 ? 0 : -1;
+    if (result == 0 && rename(temp, to) != 0)
+        result = -1;
+    if (result != 0)
+        unlink(temp);
+    free(temp);
+    return result;
+}
+
+int cache_fetch(const BuildCache *cache, const char *output_name)
+{
+    if (!cache->entry || access(cache->entry, X_OK) != 0)
+        return -1;
+    return install_file(cache->entry, output_name);
+}
+
+void cache_store(const BuildCache *cache, const char *output_name)
+{
+    if (!cache->entry)
+        return;
+    // 存一份独立的副本：以后有人原地改写output_name也不会污染缓存
+    char *temp = temp_name(cache->entry);
+    if (copy_file(output_name, temp) != 0 || rename(temp, cache->entry) != 0)
+        unlink(temp);
+    free(temp);
+}
+
+char *cache_bytecode_entry(const BuildCache *cache, const char *input_name)
+{
+    struct stat st;
+    char resolved[PATH_MAX];
+    if (stat(input_name, &st) != 0 || !S_ISREG(st.st_mode) || !realpath(input_name, resolved))
+        return NULL;
+    // 只看文件的身份，不读内容：命中时连源码都不用打开
+    Sha256 hash;
+    sha256_init(&hash);
+    uint32_t version = HCB_VERSION;
+    sha256_update(&hash, &version, sizeof(version));
+    sha256_update(&hash, resolved, strlen(resolved) + 1);
+    long long identity[5] = {(long long)st.st_dev, (long long)st.st_ino, (long long)st.st_size,
+                             (long long)st.st_mtim.tv_sec, (long long)st.st_mtim.tv_nsec};
+    sha256_update(&hash, identity, sizeof(identity));
+    uint8_t digest[32];
+    sha256_final(&hash, digest);
+    char name[64] = "bc-";
+    for (int i = 0; i < 20; i++)
+        snprintf(name + 3 + i * 2, 3, "%02x", digest[i]);
+    strcat(name, ".hcb");
+    return join_path(cache->dir, name);
+}
+
+int cache_store_file(const char *path, const StrBuf *contents)
+{
+    char *temp = temp_name(path);
+    int result = strbuf_write_file(contents, temp, 0666) == 0 && rename(temp, path) == 0 ? 0 : -1;
+    if (result != 0)
+        unlink(temp);
+    free(temp);
+    return result;
+}
@@ -1,160 +1,504 @@
 #include "codegen.h"
-#include <stdio.h>
+#include "headers.h"
 #include <stdlib.h>
 #include <string.h>
-static FunctionDef **global_functions = NULL;
-static int global_function_count = 0;
-static int global_functions_capacity = 0;
 
-// 字符串转义函数
-char *escape_string(const char *input)
+// 任意字节写成C字符串字面量的内容：换行写成\n，其余控制字符用三位八进制，后面跟数字也不会被吞进转义里
+static void append_c_bytes(StrBuf *output, const char *data, size_t length)
 {
-    if (!input)
-        return strdup("");
+    const char *run = data;
+    const char *end = data + length;
+    for (const char *c = data; c < end; c++)
+    {
+        unsigned char byte = (unsigned char)*c;
+        if (byte >= 0x20 && byte != 0x7f && byte != '\\' && byte != '"')
+            continue;
+        strbuf_append(output, run, c - run);
+        if (byte == '\\' || byte == '"')
+            strbuf_printf(output, "\\%c", byte);
+        else if (byte == '\n')
+            strbuf_puts(output, "\\n");
+        else
+            strbuf_printf(output, "\\%03o", byte);
+        run = c + 1;
+    }
+    strbuf_append(output, run, end - run);
+}
 
-    // 计算需要多少额外空间
-    size_t len = strlen(input);
-    size_t extra = 0;
-    for (const char *c = input; *c; c++)
+// 把从first开始连续的say合并成一个预先算好的字符串字面量，一次fwrite输出，返回这一段之后的下标。
+// 内联展开后调用处的say也和前后的say相邻，一并合并。
+// main里的say原来不转义，C转义由gcc解释、printf遇到'\0'停止，这里用decode_c_literal得到同样的字节
+static uint32_t emit_say_run(StrBuf *output, const FlatAST *ast, uint32_t first, uint32_t end, int in_main,
+                             StrBuf *scratch)
+{
+    size_t total = 0;
+    strbuf_puts(output, "    fwrite(");
+    uint32_t i;
+    for (i = first; i < end && ast->kinds[i] == STMT_SAY; i++)
     {
-        if (*c == '\\' || *c == '"')
-            extra++;
+        const char *text = flat_ast_string(ast, i);
+        size_t length = strnlen(text, ast->payload_length[i]);
+        if (in_main && memchr(text, '\\', length))
+        {
+            strbuf_reset(scratch);
+            decode_c_literal(text, length, scratch);
+            text = scratch->data;
+            length = scratch->length;
+        }
+        if (i > first)
+            strbuf_puts(output, "\n           ");
+        strbuf_puts(output, "\"");
+        append_c_bytes(output, text, length);
+        strbuf_puts(output, "\\n\"");
+        total += length + 1;
     }
+    strbuf_printf(output, ", 1, %zu, stdout);\n", total);
+    return i;
+}
+
+// 求值时按名字在字符串池中的偏移查函数，驻留过的名字偏移相同
+typedef struct FunctionEntry
+{
+    uint32_t name;
+    uint32_t node;
+} FunctionEntry;
+
+static int compare_function_entry(const void *a, const void *b)
+{
+    uint32_t x = ((const FunctionEntry *)a)->name, y = ((const FunctionEntry *)b)->name;
+    return (x > y) - (x < y);
+}
+
+// 求值用的调用栈：每层是一段还没执行完的语句
+typedef struct EvalFrame
+{
+    uint32_t next;
+    uint32_t end;
+} EvalFrame;
+
+// 求值前沿调用图算出每个函数展开后的输出字节数、调用次数和调用层数，被调用者先算完。
+// start:能走到递归或者任何一项超过上限时返回-1，不用真的执行到上限才放弃
+typedef struct FunctionCost
+{
+    uint64_t bytes;
+    uint64_t calls;
+    uint32_t depth; // 函数体里最深的一串调用
+    int state;      // 0没访问，1还在栈上，2算完了
+} FunctionCost;
 
-    // 分配内存
-    char *output = malloc(len + extra + 1);
-    if (!output)
-        return NULL;
+typedef struct CostFrame
+{
+    uint32_t function; // 在functions里的下标，main用UINT32_MAX
+    uint32_t next;
+    uint32_t end;
+    FunctionCost cost;
+} CostFrame;
+
+static int cost_exceeds_limits(const FunctionCost *cost)
+{
+    return cost->bytes > PRECOMPUTE_MAX_OUTPUT || cost->calls > PRECOMPUTE_MAX_CALLS ||
+           cost->depth >= PRECOMPUTE_MAX_DEPTH;
+}
 
-    char *dst = output;
-    for (const char *src = input; *src; src++)
+static int estimate_output(const FlatAST *ast, const FunctionEntry *functions, uint32_t function_count)
+{
+    FunctionCost *costs = calloc(function_count ? function_count : 1, sizeof(FunctionCost));
+    CostFrame *frames = malloc((function_count + 1) * sizeof(CostFrame));
+    if (!costs || !frames)
+    {
+        free(costs);
+        free(frames);
+        return -1;
+    }
+    int depth = 1;
+    int status = 0;
+    frames[0] = (CostFrame){UINT32_MAX, 0, ast->root_count, {0, 0, 0, 1}};
+    while (status == 0)
     {
-        if (*src == '\\' || *src == '"')
+        CostFrame *frame = &frames[depth - 1];
+        if (frame->next == frame->end)
         {
-            *dst++ = '\\'; // 添加转义字符
+            if (--depth == 0)
+                break;
+            // 函数算完了，按一次调用加到调用者身上
+            FunctionCost *done = &costs[frame->function];
+            *done = frame->cost;
+            done->state = 2;
+            FunctionCost *caller = &frames[depth - 1].cost;
+            caller->bytes += done->bytes;
+            caller->calls += done->calls + 1;
+            if (done->depth + 1 > caller->depth)
+                caller->depth = done->depth + 1;
+            if (cost_exceeds_limits(caller))
+                status = -1;
+            continue;
+        }
+        uint32_t node = frame->next++;
+        if (ast->kinds[node] == STMT_SAY)
+        {
+            frame->cost.bytes += ast->payload_length[node] + 1;
+            if (cost_exceeds_limits(&frame->cost))
+                status = -1;
+            continue;
+        }
+        if (ast->kinds[node] != STMT_FUNCTION_CALL)
+            continue;
+        FunctionEntry key = {ast->payload[node], 0};
+        const FunctionEntry *callee = bsearch(&key, functions, function_count, sizeof(FunctionEntry),
+                                              compare_function_entry);
+        if (!callee)
+        {
+            status = -1;
+            continue;
+        }
+        uint32_t index = (uint32_t)(callee - functions);
+        FunctionCost *cost = &costs[index];
+        if (cost->state == 1)
+        {
+            status = -1; // 递归
+        }
+        else if (cost->state == 2)
+        {
+            frame->cost.bytes += cost->bytes;
+            frame->cost.calls += cost->calls + 1;
+            if (cost->depth + 1 > frame->cost.depth)
+                frame->cost.depth = cost->depth + 1;
+            if (cost_exceeds_limits(&frame->cost))
+                status = -1;
+        }
+        else
+        {
+            cost->state = 1;
+            uint32_t first = ast->first_child[callee->node];
+            frames[depth++] = (CostFrame){index, first, first + ast->child_count[callee->node], {0, 0, 0, 1}};
         }
-        *dst++ = *src;
     }
-    *dst = '\0';
-    return output;
+    free(costs);
+    free(frames);
+    return status;
 }
 
-void generate_c_code(const char *c_header, ASTNode **nodes, int count, FILE *output)
+int precompute_output(const FlatAST *ast, StrBuf *output)
 {
+    FunctionEntry *functions = malloc((ast->root_count ? ast->root_count : 1) * sizeof(FunctionEntry));
+    EvalFrame *frames = malloc(PRECOMPUTE_MAX_DEPTH * sizeof(EvalFrame));
+    if (!functions || !frames)
+    {
+        free(functions);
+        free(frames);
+        return -1;
+    }
+    uint32_t function_count = 0;
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] == STMT_FUNCTION_DEF)
+            functions[function_count++] = (FunctionEntry){ast->payload[i], i};
+    }
+    qsort(functions, function_count, sizeof(FunctionEntry), compare_function_entry);
+    if (estimate_output(ast, functions, function_count) != 0)
+    {
+        free(functions);
+        free(frames);
+        return -1;
+    }
+
+    size_t start = output->length;
+    long calls = 0;
+    int depth = 1;
+    int status = 0;
+    frames[0] = (EvalFrame){0, ast->root_count};
+    while (depth > 0 && status == 0)
+    {
+        EvalFrame *frame = &frames[depth - 1];
+        if (frame->next == frame->end)
+        {
+            depth--;
+            continue;
+        }
+        uint32_t node = frame->next++;
+        if (ast->kinds[node] == STMT_SAY)
+        {
+            // main里的say按C转义解码，函数里的原样输出，和generate_c_code生成的程序一致
+            const char *text = flat_ast_string(ast, node);
+            size_t length = strnlen(text, ast->payload_length[node]);
+            if (depth == 1 && memchr(text, '\\', length))
+                decode_c_literal(text, length, output);
+            else
+                strbuf_append(output, text, length);
+            strbuf_append(output, "\n", 1);
+            if (output->length - start > PRECOMPUTE_MAX_OUTPUT)
+                status = -1;
+        }
+        else if (ast->kinds[node] == STMT_FUNCTION_CALL)
+        {
+            FunctionEntry key = {ast->payload[node], 0};
+            const FunctionEntry *callee = bsearch(&key, functions, function_count, sizeof(FunctionEntry),
+                                                  compare_function_entry);
+            if (!callee || depth == PRECOMPUTE_MAX_DEPTH || ++calls > PRECOMPUTE_MAX_CALLS)
+            {
+                status = -1;
+                continue;
+            }
+            uint32_t first = ast->first_child[callee->node];
+            frames[depth++] = (EvalFrame){first, first + ast->child_count[callee->node]};
+        }
+    }
+
+    if (status != 0)
+        output->length = start;
+    if (output->data)
+        output->data[output->length] = '\0';
+    free(functions);
+    free(frames);
+    return status;
+}
+
+// 只有一次write的程序：输出按行拆成相邻的字符串字面量，由C编译器拼接
+static void generate_static_program(const char *data, size_t length, StrBuf *output)
+{
+    strbuf_puts(output, "#include <unistd.h>\n\n/* Output precomputed at compile time */\n");
+    strbuf_puts(output, "static const char output[] =");
+    if (length == 0)
+        strbuf_puts(output, " \"\"");
+    const char *end = data + length;
+    for (const char *line = data; line < end;)
+    {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *next = newline ? newline + 1 : end;
+        strbuf_puts(output, "\n    \"");
+        append_c_bytes(output, line, next - line);
+        strbuf_puts(output, "\"");
+        line = next;
+    }
+    strbuf_printf(output, ";\n\nint main() {\n"
+                          "    const char *data = output;\n"
+                          "    size_t left = %zu;\n"
+                          "    while (left > 0) {\n"
+                          "        ssize_t written = write(1, data, left);\n"
+                          "        if (written <= 0)\n"
+                          "            break;\n"
+                          "        data += written;\n"
+                          "        left -= written;\n"
+                          "    }\n"
+                          "    return 0;\n}\n",
+                  length);
+}
+
+void write_standard_includes(StrBuf *output, unsigned headers)
+{
+    for (int i = 0; i < HEADER_COUNT; i++)
+    {
+        if (headers & HEADER_BIT(i))
+            strbuf_printf(output, "#include <%s>\n", standard_headers[i]);
+    }
+}
+
+void generate_c_code(const char *c_header, size_t c_header_length, const FlatAST *ast, IncludeMode includes,
+                     int precompute, StrBuf *output)
+{
+    // 没有C前导代码时程序只有say和调用，输出在编译期就能算出来
+    if (c_header == NULL && precompute)
+    {
+        StrBuf precomputed;
+        strbuf_init(&precomputed);
+        int status = precompute_output(ast, &precomputed);
+        if (status == 0)
+            generate_static_program(precomputed.data, precomputed.length, output);
+        strbuf_free(&precomputed);
+        if (status == 0)
+            return;
+    }
+
     // 写入C头文件部分
-    fprintf(output, "#include <stdio.h>\n");
-    fprintf(output, "#include <stdlib.h>\n");
-    fprintf(output, "#include <string.h>\n");
-    fprintf(output, "#include <math.h>\n");
-    fprintf(output, "#include <time.h>\n");
-    fprintf(output, "#include <ctype.h>\n");
-    fprintf(output, "#include <float.h>\n");
-    fprintf(output, "#include <assert.h>\n");
-    fprintf(output, "#include <errno.h>\n");
-    fprintf(output, "#include <stddef.h>\n");
-    fprintf(output, "#include <signal.h>\n");
-    fprintf(output, "#include <setjmp.h>\n");
-    fprintf(output, "#include <locale.h>\n\n");
-
-    // 首先收集所有函数定义
-    for (int i = 0; i < count; i++)
-    {
-        if (nodes[i]->type == STMT_FUNCTION_DEF)
-        {
-            // 检查是否需要扩容
-            if (global_function_count >= global_functions_capacity)
+    if (includes != INCLUDE_NONE)
+    {
+        unsigned headers = HEADER_ALL;
+        if (includes == INCLUDE_USED)
+        {
+            // say要用printf，其余的看C前导代码里出现了哪些标准库名字
+            headers = c_header ? headers_used_by(c_header, c_header_length) : 0;
+            for (uint32_t i = 0; i < ast->count; i++)
             {
-                int new_capacity = global_functions_capacity == 0 ? 8 : global_functions_capacity * 2;
-                FunctionDef **new_functions = realloc(global_functions, new_capacity * sizeof(FunctionDef *));
-                if (!new_functions)
+                if (ast->kinds[i] == STMT_SAY)
                 {
-                    fprintf(stderr, "Memory allocation failed\n");
-                    exit(1);
+                    headers |= HEADER_BIT(HEADER_STDIO);
+                    break;
                 }
-                global_functions = new_functions;
-                global_functions_capacity = new_capacity;
             }
-
-            FunctionDef *def = malloc(sizeof(FunctionDef));
-            def->name = strdup(nodes[i]->value);
-            def->body = nodes[i]->body;
-            def->body_count = nodes[i]->body_count;
-
-            global_functions[global_function_count++] = def;
         }
+        write_standard_includes(output, headers);
     }
+    strbuf_puts(output, "\n");
 
-    // 生成函数声明（所有函数都返回void）
-    fprintf(output, "\n/* Function declarations */\n");
-    for (int i = 0; i < global_function_count; i++)
-        fprintf(output, "void function_%s();\n", global_functions[i]->name);
+    // 生成函数声明（所有函数都返回void），函数定义就是类型为DEF的顶层节点
+    strbuf_puts(output, "\n/* Function declarations */\n");
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] == STMT_FUNCTION_DEF)
+            strbuf_printf(output, "void function_%s();\n", flat_ast_string(ast, i));
+    }
     // 生成main函数
-    fprintf(output, "\nint main() {\n");
+    strbuf_puts(output, "\nint main() {\n");
     // 如果有外部C代码头文件，写入它
     if (c_header != NULL)
     {
-        // 逐行处理 c_header
+        // 逐行处理 c_header，它只是源码上的一段视图，不以'\0'结尾
         const char *start = c_header;
+        const char *header_end = c_header + c_header_length;
         const char *end;
-        while ((end = strchr(start, '\n')) != NULL)
+        while ((end = memchr(start, '\n', header_end - start)) != NULL)
         { // 找到换行符
             // 输出：制表符 + 当前行（不含换行符）
-            fprintf(output, "\t%.*s\n", (int)(end - start), start);
+            strbuf_append(output, "\t", 1);
+            strbuf_append(output, start, end - start + 1);
             start = end + 1; // 移到下一行
         }
         // 输出剩余部分（最后一行）
-        if (*start != '\0')
+        if (start < header_end)
         {
-            fprintf(output, "\t%s\n", start);
+            strbuf_append(output, "\t", 1);
+            strbuf_append(output, start, header_end - start);
+            strbuf_append(output, "\n", 1);
         }
     }
-    for (int i = 0; i < count; i++)
+    StrBuf scratch;
+    strbuf_init(&scratch);
+    for (uint32_t i = 0; i < ast->root_count;)
     {
-        if (nodes[i]->type == STMT_SAY)
-            fprintf(output, "    printf(\"%%s\\n\", \"%s\");\n", nodes[i]->value);
-        else if (nodes[i]->type == STMT_FUNCTION_CALL)
-            fprintf(output, "    function_%s();\n", nodes[i]->value);
+        if (ast->kinds[i] == STMT_SAY)
+        {
+            i = emit_say_run(output, ast, i, ast->root_count, 1, &scratch);
+            continue;
+        }
+        if (ast->kinds[i] == STMT_FUNCTION_CALL)
+            strbuf_printf(output, "    function_%s();\n", flat_ast_string(ast, i));
+        i++;
     }
-    fprintf(output, "    return 0;\n}\n");
+    strbuf_puts(output, "    return 0;\n}\n");
 
-    // 生成函数实现
-    fprintf(output, "\n/* Function implementations */\n");
-    for (int i = 0; i < global_function_count; i++)
+    // 生成函数实现，函数体是一段连续的子节点
+    strbuf_puts(output, "\n/* Function implementations */\n");
+    for (uint32_t i = 0; i < ast->root_count; i++)
     {
-        FunctionDef *def = global_functions[i];
-        fprintf(output, "void function_%s() {\n", def->name);
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            continue;
+        strbuf_printf(output, "void function_%s() {\n", flat_ast_string(ast, i));
 
-        for (int j = 0; j < def->body_count; j++)
+        uint32_t end = ast->first_child[i] + ast->child_count[i];
+        for (uint32_t stmt = ast->first_child[i]; stmt < end;)
         {
-            ASTNode *stmt = def->body[j];
-
-            if (stmt->type == STMT_SAY)
+            if (ast->kinds[stmt] == STMT_SAY)
             {
-                char *escaped = escape_string(stmt->value);
-                fprintf(output, "    printf(\"%%s\\n\", \"%s\");\n", escaped);
-                free(escaped);
-            }
-            else if (stmt->type == STMT_FUNCTION_CALL)
-            {
-                fprintf(output, "    function_%s();\n", stmt->value);
+                stmt = emit_say_run(output, ast, stmt, end, 0, &scratch);
+                continue;
             }
+            if (ast->kinds[stmt] == STMT_FUNCTION_CALL)
+                strbuf_printf(output, "    function_%s();\n", flat_ast_string(ast, stmt));
+            stmt++;
         }
 
-        fprintf(output, "}\n\n");
+        strbuf_puts(output, "}\n\n");
     }
+    strbuf_free(&scratch);
+}
 
-    // 清理
-    for (int i = 0; i < global_function_count; i++)
+static void append_utf8(StrBuf *out, uint32_t c)
+{
+    char bytes[4];
+    int n;
+    if (c < 0x80)
     {
-        free(global_functions[i]);
+        bytes[0] = c;
+        n = 1;
     }
-    free(global_functions);
-    global_function_count = 0;
+    else if (c < 0x800)
+    {
+        bytes[0] = 0xc0 | (c >> 6);
+        bytes[1] = 0x80 | (c & 0x3f);
+        n = 2;
+    }
+    else if (c < 0x10000)
+    {
+        bytes[0] = 0xe0 | (c >> 12);
+        bytes[1] = 0x80 | ((c >> 6) & 0x3f);
+        bytes[2] = 0x80 | (c & 0x3f);
+        n = 3;
+    }
+    else
+    {
+        bytes[0] = 0xf0 | (c >> 18);
+        bytes[1] = 0x80 | ((c >> 12) & 0x3f);
+        bytes[2] = 0x80 | ((c >> 6) & 0x3f);
+        bytes[3] = 0x80 | (c & 0x3f);
+        n = 4;
+    }
+    strbuf_append(out, bytes, n);
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+        return (c | 0x20) - 'a' + 10;
+    return -1;
 }
 
-void compile(char *c_filename, char *output_name)
+void decode_c_literal(const char *text, size_t length, StrBuf *out)
 {
-    char cmd[256];
-    sprintf(cmd, "gcc -O2 -o %s %s", output_name, c_filename);
-    system(cmd);
+    const char *p = text, *end = text + length;
+    while (p < end)
+    {
+        if (*p != '\\' || p + 1 == end)
+        {
+            strbuf_append(out, p++, 1);
+            continue;
+        }
+        p++;
+        uint32_t c;
+        switch (*p)
+        {
+        case 'n': c = '\n'; p++; break;
+        case 't': c = '\t'; p++; break;
+        case 'r': c = '\r'; p++; break;
+        case 'a': c = '\a'; p++; break;
+        case 'b': c = '\b'; p++; break;
+        case 'f': c = '\f'; p++; break;
+        case 'v': c = '\v'; p++; break;
+        case 'e': c = 27; p++; break;
+        case 'x':
+            c = 0;
+            for (p++; p < end && hex_value(*p) >= 0; p++)
+                c = (c << 4) | hex_value(*p);
+            c &= 0xff;
+            break;
+        case 'u':
+        case 'U':
+        {
+            int digits = *p == 'u' ? 4 : 8;
+            c = 0;
+            for (p++; digits > 0 && p < end && hex_value(*p) >= 0; p++, digits--)
+                c = (c << 4) | hex_value(*p);
+            append_utf8(out, c);
+            continue;
+        }
+        default:
+            if (*p >= '0' && *p <= '7')
+            {
+                c = 0;
+                for (int i = 0; i < 3 && p < end && *p >= '0' && *p <= '7'; i++, p++)
+                    c = (c << 3) | (*p - '0');
+                c &= 0xff;
+            }
+            else
+            {
+                c = (unsigned char)*p++; // \\ \" \' \? 以及不认识的转义都是字符本身
+            }
+            break;
+        }
+        if (c == 0)
+            return;
+        char byte = (char)c;
+        strbuf_append(out, &byte, 1);
+    }
 }
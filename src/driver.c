@@ -0,0 +1,564 @@
+#include "driver.h"
+#include "source.h"
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "backend.h"
+#include "cache.h"
+#include "native.h"
+#include "interp.h"
+#include "bytecode.h"
+#include "optimize.h"
+#include "trace.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 批量编译的共享状态，全部由lock保护
+typedef struct Batch
+{
+    const DriverOptions *options;
+    BuildJob *jobs;
+    int count;
+    int next;             // 下一个待领取的任务
+    int backends_free;    // 还能再启动几个gcc
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // 有任务完成或有gcc名额空出来
+} Batch;
+
+static void acquire_backend(Batch *batch)
+{
+    pthread_mutex_lock(&batch->lock);
+    while (batch->backends_free == 0)
+        pthread_cond_wait(&batch->changed, &batch->lock);
+    batch->backends_free--;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+static void release_backend(Batch *batch)
+{
+    pthread_mutex_lock(&batch->lock);
+    batch->backends_free++;
+    pthread_cond_broadcast(&batch->changed);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// 生成C代码，命中缓存时直接取出可执行文件，否则交给gcc
+static int build_with_gcc(const DriverOptions *options, const char *c_header, size_t c_header_length,
+                          const FlatAST *ast, const char *output_name, FILE *diagnostics, TimeReport *report,
+                          Batch *batch)
+{
+    // 缓存目录同时存放可执行文件缓存和预编译头
+    int use_cache = options->use_cache;
+    BuildCache cache;
+    int have_cache_dir = 0;
+    if (use_cache || options->pch)
+    {
+        have_cache_dir = cache_open(&cache, options->cache_dir) == 0;
+        if (!have_cache_dir && options->cache_dir)
+            fprintf(diagnostics, "Warning: cannot use cache directory %s\n", options->cache_dir);
+    }
+    use_cache = use_cache && have_cache_dir;
+
+    // 预编译头提供全部标准头文件，生成的代码里就不再#include
+    char *prelude = NULL;
+    if (options->pch)
+    {
+        if (have_cache_dir)
+            prelude = cache_prepare_pch(&cache, diagnostics);
+        if (!prelude)
+            fprintf(diagnostics, "Warning: precompiled header unavailable, including headers directly\n");
+        report_end(report, "pch");
+    }
+
+    // 生成C代码，整个程序先写进内存缓冲区
+    StrBuf c_code;
+    strbuf_init(&c_code);
+    generate_c_code(c_header, c_header_length, ast, prelude ? INCLUDE_NONE : INCLUDE_USED, options->precompute,
+                    &c_code);
+    report_end(report, "codegen");
+    if (options->emit_c)
+    {
+        // 先删掉旧文件：它可能是指向缓存条目的硬链接，原地截断会改写缓存
+        unlink(options->emit_c);
+        if (strbuf_write_file(&c_code, options->emit_c, 0666) != 0)
+            fprintf(diagnostics, "Error writing C file: %s\n", options->emit_c);
+        report_end(report, "write C");
+    }
+
+    // 生成的C代码完全相同时直接复用缓存里的可执行文件
+    int cache_hit = 0;
+    if (use_cache)
+    {
+        cache_set_key(&cache, &c_code, prelude);
+        cache_hit = cache_fetch(&cache, output_name) == 0;
+        TRACE(TRACE_DRIVER, "Cache %s: %s\n", cache_hit ? "hit" : "miss", cache.key);
+        report_end(report, "cache lookup");
+    }
+
+    // 编译：通过管道把缓冲区交给后端编译器
+    int compile_status = 0;
+    if (!cache_hit)
+    {
+        // 输出文件可能是上次命中时链接过来的缓存项，先断开，免得覆盖缓存
+        if (use_cache)
+            unlink(output_name);
+        if (batch)
+            acquire_backend(batch);
+        compile_status = compile(&c_code, output_name, prelude, diagnostics);
+        if (batch)
+            release_backend(batch);
+        report_end(report, "gcc");
+        if (use_cache && compile_status == 0)
+        {
+            cache_store(&cache, output_name);
+            report_end(report, "cache store");
+        }
+    }
+    if (have_cache_dir)
+        cache_close(&cache);
+    free(prelude);
+
+    report_count(report, "generated_c_bytes", (long long)c_code.length);
+    report_count(report, "strbuf_allocations", (long long)c_code.allocations);
+    report_count(report, "cache_hit", cache_hit);
+    strbuf_free(&c_code);
+
+    if (compile_status != 0)
+    {
+        fprintf(diagnostics, "Error: %s failed to build %s\n", HERCODE_BACKEND_CC, output_name);
+        return 1;
+    }
+    return 0;
+}
+
+// 直接写出ELF可执行文件，不启动任何进程
+static int build_native(const char *c_header, const FlatAST *ast, const char *output_name, FILE *diagnostics,
+                        TimeReport *report)
+{
+    if (c_header)
+    {
+        fprintf(diagnostics, "Error: --backend=native does not support a C prelude\n");
+        return 1;
+    }
+    StrBuf image;
+    strbuf_init(&image);
+    if (emit_native_executable(ast, &image) != 0)
+    {
+        fprintf(diagnostics, "Error: program is too large for --backend=native\n");
+        strbuf_free(&image);
+        return 1;
+    }
+    report_end(report, "native codegen");
+
+    // 先删掉旧文件，免得它是缓存项的硬链接；新建时的权限和链接器一样是0777减去umask
+    unlink(output_name);
+    int result = strbuf_write_file(&image, output_name, 0777);
+    report_end(report, "write");
+    report_count(report, "executable_bytes", (long long)image.length);
+    report_count(report, "strbuf_allocations", (long long)image.allocations);
+    strbuf_free(&image);
+    if (result != 0)
+    {
+        fprintf(diagnostics, "Error writing executable: %s\n", output_name);
+        return 1;
+    }
+    return 0;
+}
+
+// 一个源文件的前端结果：映射的源码、C前导代码的视图和AST，AST归arena所有
+typedef struct Frontend
+{
+    SourceFile source;
+    const char *c_header;
+    size_t c_header_length;
+    Arena arena;
+    InternTable strings;
+    Parser *parser;
+    ASTNode **nodes;
+    int node_count;
+} Frontend;
+
+static void frontend_free(Frontend *front)
+{
+    free_parser(front->parser);
+    intern_free(&front->strings);
+    arena_free(&front->arena);
+    close_source_file(&front->source);
+}
+
+// 读取、分离、词法和语法分析，失败时已经输出诊断并释放了所有资源
+static int frontend_parse(Frontend *front, const char *input_name, FILE *diagnostics, TimeReport *report)
+{
+    // 只读映射整个文件
+    if (open_source_file(input_name, &front->source) != 0)
+    {
+        fprintf(diagnostics, "Error reading file: %s\n", input_name);
+        return 1;
+    }
+
+    // 尝试分离C头部分，两部分都只是映射内存上的视图
+    front->c_header = NULL;
+    front->c_header_length = 0;
+    const char *hercode_source = NULL;
+    separate_header(front->source.data, front->source.size, "Hello! Her World",
+                    &front->c_header, &front->c_header_length, &hercode_source);
+    if (front->c_header)
+        TRACE(TRACE_DRIVER, "C Code:\n%.*s\n", (int)front->c_header_length, front->c_header);
+    else
+        TRACE(TRACE_DRIVER, "C Code:\n(null)\n");
+    // 验证分离结果
+    if (hercode_source == NULL)
+        hercode_source = front->source.data; // 如果分离失败，使用整个文件
+
+    // 输出分离结果用于调试
+    TRACE(TRACE_DRIVER, "HerCode Source to Parse:\n%s\n", hercode_source);
+    report_end(report, "read/split");
+
+    // 创建词法分析器和解析器，AST全部分配在本次编译的arena里
+    arena_init(&front->arena);
+    intern_init(&front->strings, &front->arena);
+    Lexer *lexer = new_lexer(hercode_source);
+    front->parser = new_parser(lexer, &front->arena, &front->strings); // 会一次性完成词法分析
+    front->parser->diagnostics = diagnostics;
+    report_end(report, "lex");
+
+    // 解析程序
+    front->nodes = parse_program(front->parser, &front->node_count);
+    if (!front->nodes)
+    {
+        frontend_free(front);
+        return 1;
+    }
+    TRACE(TRACE_DRIVER, "Parsed %d nodes\n", front->node_count);
+    report_end(report, "parse");
+    return 0;
+}
+
+// 去掉start:调用不到的函数，返回去掉的个数
+static int remove_dead_functions(const DriverOptions *options, Frontend *front, FILE *diagnostics)
+{
+    ASTNode **removed = options->print_removed ? malloc(front->node_count * sizeof(ASTNode *) + 1) : NULL;
+    int removed_count;
+    front->node_count = remove_unreachable_functions(front->nodes, front->node_count, &front->parser->functions,
+                                                     &front->strings, front->c_header, front->c_header_length,
+                                                     removed, &removed_count);
+    for (int i = 0; removed && i < removed_count; i++)
+        fprintf(diagnostics, "Removed unreachable function: %s\n", removed[i]->value);
+    free(removed);
+    return removed_count;
+}
+
+// 先去掉调用不到的函数，内联只处理真正会输出的代码，统计的展开次数也只算这些；
+// 展开后不再被调用的函数再去掉一次。后面的各个后端都不再看到它们
+static void optimize_program(const DriverOptions *options, Frontend *front, FILE *diagnostics, TimeReport *report)
+{
+    int removed_count = 0;
+    if (!options->keep_unused)
+    {
+        removed_count = remove_dead_functions(options, front, diagnostics);
+        report_end(report, "dead functions");
+    }
+    if (options->inline_limit > 0)
+    {
+        int inlined;
+        front->nodes = inline_functions(front->nodes, &front->node_count, &front->parser->functions, &front->arena,
+                                        options->inline_limit, &inlined);
+        TRACE(TRACE_DRIVER, "Inlined %d call(s)\n", inlined);
+        report_end(report, "inline");
+        report_count(report, "calls_inlined", inlined);
+        if (!options->keep_unused)
+        {
+            removed_count += remove_dead_functions(options, front, diagnostics);
+            report_end(report, "dead (inlined)");
+        }
+    }
+    if (options->keep_unused)
+        return;
+    TRACE(TRACE_DRIVER, "Removed %d unreachable function(s)\n", removed_count);
+    report_count(report, "functions_removed", removed_count);
+}
+
+// 写出.hcb字节码文件，之后用--run执行
+static int build_bytecode(const char *c_header, const FlatAST *ast, const char *output_name, FILE *diagnostics,
+                          TimeReport *report)
+{
+    if (c_header)
+    {
+        fprintf(diagnostics, "Error: --backend=bytecode does not support a C prelude\n");
+        return 1;
+    }
+    StrBuf image;
+    strbuf_init(&image);
+    bytecode_compile(ast, &image);
+    report_end(report, "bytecode");
+    // 输出文件可能是gcc缓存命中时装上的硬链接，原地写会破坏缓存里的可执行文件
+    unlink(output_name);
+    int result = strbuf_write_file(&image, output_name, 0666);
+    report_end(report, "write");
+    report_count(report, "bytecode_bytes", (long long)image.length);
+    report_count(report, "strbuf_allocations", (long long)image.allocations);
+    strbuf_free(&image);
+    if (result != 0)
+    {
+        fprintf(diagnostics, "Error writing bytecode: %s\n", output_name);
+        return 1;
+    }
+    return 0;
+}
+
+// batch为NULL时是单文件编译，不限制gcc数量
+static int build_one(const DriverOptions *options, const char *input_name, const char *output_name,
+                     FILE *diagnostics, TimeReport *report, Batch *batch)
+{
+    Frontend front;
+    if (frontend_parse(&front, input_name, diagnostics, report) != 0)
+        return 1;
+    optimize_program(options, &front, diagnostics, report);
+
+    // 展开成扁平AST，后续各阶段都在它上面线性遍历
+    FlatAST ast;
+    flat_ast_init(&ast);
+    flatten_program(front.nodes, front.node_count, &ast);
+    report_end(report, "flatten");
+
+    int status;
+    if (options->backend == BACKEND_NATIVE)
+        status = build_native(front.c_header, &ast, output_name, diagnostics, report);
+    else if (options->backend == BACKEND_BYTECODE)
+        status = build_bytecode(front.c_header, &ast, output_name, diagnostics, report);
+    else
+        status = build_with_gcc(options, front.c_header, front.c_header_length, &ast, output_name, diagnostics,
+                                report, batch);
+
+    report_count(report, "source_bytes", (long long)front.source.size);
+    report_count(report, "tokens", (long long)front.parser->tokens.count);
+    report_count(report, "token_array_bytes", (long long)front.parser->tokens.capacity * sizeof(Token));
+    report_count(report, "ast_nodes", ast.count);
+    report_count(report, "flat_ast_string_bytes", ast.strings_size);
+    report_count(report, "interned_strings", front.strings.count);
+    report_count(report, "functions", front.parser->functions.count);
+    report_count(report, "arena_bytes", (long long)front.arena.total);
+    report_count(report, "arena_blocks", (long long)front.arena.blocks);
+    // 各子系统自己的堆分配次数，arena之外的分配都在这里
+    report_count(report, "intern_allocations", front.strings.allocations);
+    report_count(report, "symtab_allocations", front.parser->functions.allocations);
+    report_count(report, "flat_ast_allocations", ast.allocations);
+
+    // 清理
+    flat_ast_free(&ast);
+    frontend_free(&front);
+    return status;
+}
+
+static int run_bytecode(const Bytecode *bytecode, FILE *diagnostics, TimeReport *report)
+{
+    int status = vm_run(bytecode, stdout, diagnostics);
+    report_end(report, "run");
+    report_count(report, "bytecode_bytes", (long long)bytecode->size);
+    report_count(report, "functions", bytecode->header->function_count);
+    return status;
+}
+
+int run_file(const DriverOptions *options, const char *input_name, FILE *diagnostics, TimeReport *report)
+{
+    // 已经编译好的.hcb直接执行
+    Bytecode bytecode;
+    if (is_bytecode_file(input_name))
+    {
+        if (bytecode_open(&bytecode, input_name) != 0)
+        {
+            fprintf(diagnostics, "Error: invalid or incompatible bytecode file: %s\n", input_name);
+            return 1;
+        }
+        report_end(report, "load");
+        int status = run_bytecode(&bytecode, diagnostics, report);
+        bytecode_close(&bytecode);
+        return status;
+    }
+
+    // 源文件没变时直接mmap上次的字节码，跳过词法和语法分析
+    char *entry = NULL;
+    BuildCache cache;
+    if (options->use_cache && cache_open(&cache, options->cache_dir) == 0)
+    {
+        entry = cache_bytecode_entry(&cache, input_name);
+        cache_close(&cache);
+    }
+    if (entry && bytecode_open(&bytecode, entry) == 0)
+    {
+        TRACE(TRACE_DRIVER, "Bytecode cache hit: %s\n", entry);
+        free(entry);
+        report_end(report, "cache lookup");
+        report_count(report, "cache_hit", 1);
+        int status = run_bytecode(&bytecode, diagnostics, report);
+        bytecode_close(&bytecode);
+        return status;
+    }
+    if (entry)
+        report_end(report, "cache lookup");
+
+    Frontend front;
+    if (frontend_parse(&front, input_name, diagnostics, report) != 0)
+    {
+        free(entry);
+        return 1;
+    }
+    int status = 1;
+    if (front.c_header)
+    {
+        fprintf(diagnostics, "Error: --run does not support a C prelude\n");
+    }
+    else if (!entry)
+    {
+        // 没有缓存可写时不值得生成字节码，直接解释AST
+        status = run_program(front.nodes, front.node_count, &front.parser->functions, stdout, diagnostics);
+        report_end(report, "run");
+        report_count(report, "ast_nodes", front.node_count);
+        report_count(report, "functions", front.parser->functions.count);
+    }
+    else
+    {
+        optimize_program(options, &front, diagnostics, report);
+        FlatAST ast;
+        flat_ast_init(&ast);
+        flatten_program(front.nodes, front.node_count, &ast);
+        StrBuf image;
+        strbuf_init(&image);
+        bytecode_compile(&ast, &image);
+        flat_ast_free(&ast);
+        if (cache_store_file(entry, &image) != 0)
+            TRACE(TRACE_DRIVER, "Failed to store bytecode in %s\n", entry);
+        report_end(report, "bytecode");
+        report_count(report, "cache_hit", 0);
+        if (bytecode_load(&bytecode, image.data, image.length) == 0)
+            status = run_bytecode(&bytecode, diagnostics, report);
+        strbuf_free(&image);
+    }
+    free(entry);
+    frontend_free(&front);
+    return status;
+}
+
+int build_file(const DriverOptions *options, const char *input_name, const char *output_name,
+               FILE *diagnostics, TimeReport *report)
+{
+    return build_one(options, input_name, output_name, diagnostics, report, NULL);
+}
+
+static void *batch_worker(void *arg)
+{
+    Batch *batch = arg;
+    while (1)
+    {
+        pthread_mutex_lock(&batch->lock);
+        int index = batch->next < batch->count ? batch->next++ : -1;
+        pthread_mutex_unlock(&batch->lock);
+        if (index < 0)
+            return NULL;
+
+        BuildJob *job = &batch->jobs[index];
+        TimeReport report; // 批量模式不输出报告，只是build_one需要一个
+        report_init(&report);
+        report_begin(&report);
+        job->status = build_one(batch->options, job->input_name, job->output_name,
+                                job->diagnostics, &report, batch);
+        fflush(job->diagnostics);
+
+        pthread_mutex_lock(&batch->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&batch->changed);
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
+
+// 把任务的诊断复制到stderr，前面标上是哪个输入文件
+static void replay_diagnostics(const BuildJob *job)
+{
+    char buffer[4096];
+    size_t n;
+    int first = 1;
+    rewind(job->diagnostics);
+    while ((n = fread(buffer, 1, sizeof(buffer), job->diagnostics)) > 0)
+    {
+        if (first)
+            fprintf(stderr, "In %s:\n", job->input_name);
+        first = 0;
+        fwrite(buffer, 1, n, stderr);
+    }
+}
+
+int build_batch(const DriverOptions *options, BuildJob *jobs, int count, int workers, int max_backends)
+{
+    Batch batch;
+    batch.options = options;
+    batch.jobs = jobs;
+    batch.count = count;
+    batch.next = 0;
+    batch.backends_free = max_backends > 0 ? max_backends : 1;
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.changed, NULL);
+
+    // 每个任务一个匿名临时文件收集诊断，gcc的stderr也直接写进去
+    for (int i = 0; i < count; i++)
+    {
+        jobs[i].status = 1;
+        jobs[i].done = 0;
+        jobs[i].diagnostics = tmpfile();
+        if (!jobs[i].diagnostics)
+        {
+            perror("tmpfile");
+            exit(1);
+        }
+        // 别的任务的gcc不需要这个文件，只有本任务的gcc通过dup2拿到它
+        fcntl(fileno(jobs[i].diagnostics), F_SETFD, FD_CLOEXEC);
+    }
+
+    if (workers > count)
+        workers = count;
+    if (workers < 1)
+        workers = 1;
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    if (!threads)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        if (pthread_create(&threads[i], NULL, batch_worker, &batch) != 0)
+        {
+            fprintf(stderr, "Failed to start worker thread\n");
+            exit(1);
+        }
+    }
+
+    // 按输入顺序等待并输出，前面的任务没完成时后面的结果先攒着
+    int failures = 0;
+    for (int i = 0; i < count; i++)
+    {
+        pthread_mutex_lock(&batch.lock);
+        while (!jobs[i].done)
+            pthread_cond_wait(&batch.changed, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+
+        replay_diagnostics(&jobs[i]);
+        fclose(jobs[i].diagnostics);
+        jobs[i].diagnostics = NULL;
+        if (jobs[i].status == 0)
+            printf("Successfully generated: %s\n", jobs[i].output_name);
+        else
+            failures++;
+        // stdout和stderr可能是同一个终端，逐个刷新才能保持交错顺序
+        fflush(stdout);
+    }
+
+    for (int i = 0; i < workers; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_cond_destroy(&batch.changed);
+    pthread_mutex_destroy(&batch.lock);
+    return failures;
+}
@@ -0,0 +1,141 @@
+#include "flat_ast.h"
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void flat_ast_init(FlatAST *ast)
+{
+    memset(ast, 0, sizeof(FlatAST));
+}
+
+void flat_ast_free(FlatAST *ast)
+{
+    free(ast->kinds);
+    free(ast->payload);
+    free(ast->payload_length);
+    free(ast->first_child);
+    free(ast->child_count);
+    free(ast->strings);
+    flat_ast_init(ast);
+}
+
+static void *grow_array(void *array, uint32_t capacity, size_t element_size)
+{
+    void *grown = realloc(array, capacity * element_size);
+    if (!grown)
+    {
+        fprintf(stderr, "Memory reallocation failed for flat AST\n");
+        exit(1);
+    }
+    return grown;
+}
+
+static uint32_t add_string(FlatAST *ast, const char *text, size_t length)
+{
+    while (ast->strings_size + length + 1 > ast->strings_capacity)
+    {
+        ast->strings_capacity = ast->strings_capacity ? ast->strings_capacity * 2 : 4096;
+        ast->strings = grow_array(ast->strings, ast->strings_capacity, 1);
+        ast->allocations++;
+    }
+    uint32_t offset = ast->strings_size;
+    if (length)
+        memcpy(ast->strings + offset, text, length);
+    ast->strings[offset + length] = '\0';
+    ast->strings_size += length + 1;
+    return offset;
+}
+
+// 驻留ID到字符串池偏移的映射，UINT32_MAX表示还没放进池里
+typedef struct StringOffsets
+{
+    uint32_t *offsets;
+    uint32_t capacity;
+} StringOffsets;
+
+static uint32_t pool_string(FlatAST *ast, StringOffsets *map, const char *text)
+{
+    if (!text)
+        return add_string(ast, "", 0);
+
+    uint32_t id = intern_id(text);
+    if (id >= map->capacity)
+    {
+        uint32_t capacity = map->capacity ? map->capacity : 256;
+        while (capacity <= id)
+            capacity *= 2;
+        map->offsets = grow_array(map->offsets, capacity, sizeof(uint32_t));
+        memset(map->offsets + map->capacity, 0xff, (capacity - map->capacity) * sizeof(uint32_t));
+        map->capacity = capacity;
+    }
+    if (map->offsets[id] == UINT32_MAX)
+        map->offsets[id] = add_string(ast, text, intern_length(text));
+    return map->offsets[id];
+}
+
+static uint32_t add_node(FlatAST *ast, StringOffsets *map, const ASTNode *node)
+{
+    if (ast->count >= ast->capacity)
+    {
+        ast->capacity = ast->capacity ? ast->capacity * 2 : 256;
+        ast->kinds = grow_array(ast->kinds, ast->capacity, sizeof(uint8_t));
+        ast->payload = grow_array(ast->payload, ast->capacity, sizeof(uint32_t));
+        ast->payload_length = grow_array(ast->payload_length, ast->capacity, sizeof(uint32_t));
+        ast->first_child = grow_array(ast->first_child, ast->capacity, sizeof(uint32_t));
+        ast->child_count = grow_array(ast->child_count, ast->capacity, sizeof(uint32_t));
+        ast->allocations += 5;
+    }
+    uint32_t index = ast->count++;
+    ast->kinds[index] = (uint8_t)node->type;
+    ast->payload[index] = pool_string(ast, map, node->value);
+    ast->payload_length[index] = node->value ? intern_length(node->value) : 0;
+    ast->first_child[index] = 0;
+    ast->child_count[index] = 0;
+    return index;
+}
+
+// 按层序展开指针树：先放所有顶层节点，再依次为每个节点追加它的子节点，
+// 这样每个节点的子节点在数组里是连续的
+void flatten_program(ASTNode **nodes, int count, FlatAST *ast)
+{
+    flat_ast_free(ast);
+
+    // 记录每个扁平节点对应的指针树节点，展开子节点时要用
+    size_t sources_capacity = count > 0 ? count : 1;
+    const ASTNode **sources = malloc(sources_capacity * sizeof(ASTNode *));
+    if (!sources)
+    {
+        fprintf(stderr, "Memory allocation failed for flat AST\n");
+        exit(1);
+    }
+    StringOffsets map = {NULL, 0};
+
+    for (int i = 0; i < count; i++)
+    {
+        sources[add_node(ast, &map, nodes[i])] = nodes[i];
+    }
+    ast->root_count = ast->count;
+
+    for (uint32_t i = 0; i < ast->count; i++)
+    {
+        const ASTNode *node = sources[i];
+        if (node->body_count == 0)
+            continue;
+
+        ast->first_child[i] = ast->count;
+        ast->child_count[i] = (uint32_t)node->body_count;
+        for (int j = 0; j < node->body_count; j++)
+        {
+            uint32_t child = add_node(ast, &map, node->body[j]);
+            if (child >= sources_capacity)
+            {
+                sources_capacity *= 2;
+                sources = grow_array(sources, (uint32_t)sources_capacity, sizeof(ASTNode *));
+            }
+            sources[child] = node->body[j];
+        }
+    }
+    free(sources);
+    free(map.offsets);
+}
@@ -0,0 +1,657 @@
+#include "headers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *const standard_headers[HEADER_COUNT] = {
+    "stdio.h", "stdlib.h", "string.h", "math.h", "time.h", "ctype.h", "float.h",
+    "assert.h", "errno.h", "stddef.h", "signal.h", "setjmp.h", "locale.h",
+};
+
+typedef struct KnownName
+{
+    const char *name;
+    unsigned headers;
+} KnownName;
+
+// 标准库里的名字及其所在的头文件，必须按strcmp的顺序排列，查找时用二分
+static const KnownName known_names[] = {
+    {"BUFSIZ", HEADER_BIT(HEADER_STDIO)},
+    {"CLOCKS_PER_SEC", HEADER_BIT(HEADER_TIME)},
+    {"CLOCK_MONOTONIC", HEADER_BIT(HEADER_TIME)},
+    {"CLOCK_REALTIME", HEADER_BIT(HEADER_TIME)},
+    {"DECIMAL_DIG", HEADER_BIT(HEADER_FLOAT)},
+    {"EOF", HEADER_BIT(HEADER_STDIO)},
+    {"EXIT_FAILURE", HEADER_BIT(HEADER_STDLIB)},
+    {"EXIT_SUCCESS", HEADER_BIT(HEADER_STDLIB)},
+    {"FILE", HEADER_BIT(HEADER_STDIO)},
+    {"FILENAME_MAX", HEADER_BIT(HEADER_STDIO)},
+    {"FLT_EVAL_METHOD", HEADER_BIT(HEADER_FLOAT)},
+    {"FLT_RADIX", HEADER_BIT(HEADER_FLOAT)},
+    {"FLT_ROUNDS", HEADER_BIT(HEADER_FLOAT)},
+    {"FOPEN_MAX", HEADER_BIT(HEADER_STDIO)},
+    {"FP_INFINITE", HEADER_BIT(HEADER_MATH)},
+    {"FP_NAN", HEADER_BIT(HEADER_MATH)},
+    {"FP_NORMAL", HEADER_BIT(HEADER_MATH)},
+    {"FP_SUBNORMAL", HEADER_BIT(HEADER_MATH)},
+    {"FP_ZERO", HEADER_BIT(HEADER_MATH)},
+    {"HUGE_VAL", HEADER_BIT(HEADER_MATH)},
+    {"HUGE_VALF", HEADER_BIT(HEADER_MATH)},
+    {"HUGE_VALL", HEADER_BIT(HEADER_MATH)},
+    {"INFINITY", HEADER_BIT(HEADER_MATH)},
+    {"L_tmpnam", HEADER_BIT(HEADER_STDIO)},
+    {"MB_CUR_MAX", HEADER_BIT(HEADER_STDLIB)},
+    {"M_E", HEADER_BIT(HEADER_MATH)},
+    {"M_PI", HEADER_BIT(HEADER_MATH)},
+    {"M_SQRT2", HEADER_BIT(HEADER_MATH)},
+    {"NAN", HEADER_BIT(HEADER_MATH)},
+    {"NULL", HEADER_BIT(HEADER_STDDEF)},
+    {"RAND_MAX", HEADER_BIT(HEADER_STDLIB)},
+    {"SEEK_CUR", HEADER_BIT(HEADER_STDIO)},
+    {"SEEK_END", HEADER_BIT(HEADER_STDIO)},
+    {"SEEK_SET", HEADER_BIT(HEADER_STDIO)},
+    {"TIME_UTC", HEADER_BIT(HEADER_TIME)},
+    {"TMP_MAX", HEADER_BIT(HEADER_STDIO)},
+    {"_Exit", HEADER_BIT(HEADER_STDLIB)},
+    {"_IOFBF", HEADER_BIT(HEADER_STDIO)},
+    {"_IOLBF", HEADER_BIT(HEADER_STDIO)},
+    {"_IONBF", HEADER_BIT(HEADER_STDIO)},
+    {"abort", HEADER_BIT(HEADER_STDLIB)},
+    {"abs", HEADER_BIT(HEADER_STDLIB)},
+    {"acos", HEADER_BIT(HEADER_MATH)},
+    {"acosh", HEADER_BIT(HEADER_MATH)},
+    {"aligned_alloc", HEADER_BIT(HEADER_STDLIB)},
+    {"asctime", HEADER_BIT(HEADER_TIME)},
+    {"asin", HEADER_BIT(HEADER_MATH)},
+    {"asinh", HEADER_BIT(HEADER_MATH)},
+    {"assert", HEADER_BIT(HEADER_ASSERT)},
+    {"at_quick_exit", HEADER_BIT(HEADER_STDLIB)},
+    {"atan", HEADER_BIT(HEADER_MATH)},
+    {"atan2", HEADER_BIT(HEADER_MATH)},
+    {"atanh", HEADER_BIT(HEADER_MATH)},
+    {"atexit", HEADER_BIT(HEADER_STDLIB)},
+    {"atof", HEADER_BIT(HEADER_STDLIB)},
+    {"atoi", HEADER_BIT(HEADER_STDLIB)},
+    {"atol", HEADER_BIT(HEADER_STDLIB)},
+    {"atoll", HEADER_BIT(HEADER_STDLIB)},
+    {"bsearch", HEADER_BIT(HEADER_STDLIB)},
+    {"calloc", HEADER_BIT(HEADER_STDLIB)},
+    {"cbrt", HEADER_BIT(HEADER_MATH)},
+    {"ceil", HEADER_BIT(HEADER_MATH)},
+    {"clearerr", HEADER_BIT(HEADER_STDIO)},
+    {"clock", HEADER_BIT(HEADER_TIME)},
+    {"clock_gettime", HEADER_BIT(HEADER_TIME)},
+    {"clock_t", HEADER_BIT(HEADER_TIME)},
+    {"copysign", HEADER_BIT(HEADER_MATH)},
+    {"cos", HEADER_BIT(HEADER_MATH)},
+    {"cosh", HEADER_BIT(HEADER_MATH)},
+    {"ctime", HEADER_BIT(HEADER_TIME)},
+    {"difftime", HEADER_BIT(HEADER_TIME)},
+    {"div", HEADER_BIT(HEADER_STDLIB)},
+    {"div_t", HEADER_BIT(HEADER_STDLIB)},
+    {"double_t", HEADER_BIT(HEADER_MATH)},
+    {"dprintf", HEADER_BIT(HEADER_STDIO)},
+    {"erf", HEADER_BIT(HEADER_MATH)},
+    {"erfc", HEADER_BIT(HEADER_MATH)},
+    {"errno", HEADER_BIT(HEADER_ERRNO)},
+    {"exit", HEADER_BIT(HEADER_STDLIB)},
+    {"exp", HEADER_BIT(HEADER_MATH)},
+    {"exp2", HEADER_BIT(HEADER_MATH)},
+    {"expm1", HEADER_BIT(HEADER_MATH)},
+    {"fabs", HEADER_BIT(HEADER_MATH)},
+    {"fclose", HEADER_BIT(HEADER_STDIO)},
+    {"fdim", HEADER_BIT(HEADER_MATH)},
+    {"feof", HEADER_BIT(HEADER_STDIO)},
+    {"ferror", HEADER_BIT(HEADER_STDIO)},
+    {"fflush", HEADER_BIT(HEADER_STDIO)},
+    {"fgetc", HEADER_BIT(HEADER_STDIO)},
+    {"fgetpos", HEADER_BIT(HEADER_STDIO)},
+    {"fgets", HEADER_BIT(HEADER_STDIO)},
+    {"fileno", HEADER_BIT(HEADER_STDIO)},
+    {"float_t", HEADER_BIT(HEADER_MATH)},
+    {"floor", HEADER_BIT(HEADER_MATH)},
+    {"fma", HEADER_BIT(HEADER_MATH)},
+    {"fmax", HEADER_BIT(HEADER_MATH)},
+    {"fmin", HEADER_BIT(HEADER_MATH)},
+    {"fmod", HEADER_BIT(HEADER_MATH)},
+    {"fopen", HEADER_BIT(HEADER_STDIO)},
+    {"fpclassify", HEADER_BIT(HEADER_MATH)},
+    {"fpos_t", HEADER_BIT(HEADER_STDIO)},
+    {"fprintf", HEADER_BIT(HEADER_STDIO)},
+    {"fputc", HEADER_BIT(HEADER_STDIO)},
+    {"fputs", HEADER_BIT(HEADER_STDIO)},
+    {"fread", HEADER_BIT(HEADER_STDIO)},
+    {"free", HEADER_BIT(HEADER_STDLIB)},
+    {"freopen", HEADER_BIT(HEADER_STDIO)},
+    {"frexp", HEADER_BIT(HEADER_MATH)},
+    {"fscanf", HEADER_BIT(HEADER_STDIO)},
+    {"fseek", HEADER_BIT(HEADER_STDIO)},
+    {"fsetpos", HEADER_BIT(HEADER_STDIO)},
+    {"ftell", HEADER_BIT(HEADER_STDIO)},
+    {"fwrite", HEADER_BIT(HEADER_STDIO)},
+    {"getc", HEADER_BIT(HEADER_STDIO)},
+    {"getchar", HEADER_BIT(HEADER_STDIO)},
+    {"getdelim", HEADER_BIT(HEADER_STDIO)},
+    {"getenv", HEADER_BIT(HEADER_STDLIB)},
+    {"getline", HEADER_BIT(HEADER_STDIO)},
+    {"gets", HEADER_BIT(HEADER_STDIO)},
+    {"gmtime", HEADER_BIT(HEADER_TIME)},
+    {"gmtime_r", HEADER_BIT(HEADER_TIME)},
+    {"hypot", HEADER_BIT(HEADER_MATH)},
+    {"ilogb", HEADER_BIT(HEADER_MATH)},
+    {"isalnum", HEADER_BIT(HEADER_CTYPE)},
+    {"isalpha", HEADER_BIT(HEADER_CTYPE)},
+    {"isblank", HEADER_BIT(HEADER_CTYPE)},
+    {"iscntrl", HEADER_BIT(HEADER_CTYPE)},
+    {"isdigit", HEADER_BIT(HEADER_CTYPE)},
+    {"isfinite", HEADER_BIT(HEADER_MATH)},
+    {"isgraph", HEADER_BIT(HEADER_CTYPE)},
+    {"isgreater", HEADER_BIT(HEADER_MATH)},
+    {"isgreaterequal", HEADER_BIT(HEADER_MATH)},
+    {"isinf", HEADER_BIT(HEADER_MATH)},
+    {"isless", HEADER_BIT(HEADER_MATH)},
+    {"islessequal", HEADER_BIT(HEADER_MATH)},
+    {"islessgreater", HEADER_BIT(HEADER_MATH)},
+    {"islower", HEADER_BIT(HEADER_CTYPE)},
+    {"isnan", HEADER_BIT(HEADER_MATH)},
+    {"isnormal", HEADER_BIT(HEADER_MATH)},
+    {"isprint", HEADER_BIT(HEADER_CTYPE)},
+    {"ispunct", HEADER_BIT(HEADER_CTYPE)},
+    {"isspace", HEADER_BIT(HEADER_CTYPE)},
+    {"isunordered", HEADER_BIT(HEADER_MATH)},
+    {"isupper", HEADER_BIT(HEADER_CTYPE)},
+    {"isxdigit", HEADER_BIT(HEADER_CTYPE)},
+    {"jmp_buf", HEADER_BIT(HEADER_SETJMP)},
+    {"labs", HEADER_BIT(HEADER_STDLIB)},
+    {"lconv", HEADER_BIT(HEADER_LOCALE)},
+    {"ldexp", HEADER_BIT(HEADER_MATH)},
+    {"ldiv", HEADER_BIT(HEADER_STDLIB)},
+    {"ldiv_t", HEADER_BIT(HEADER_STDLIB)},
+    {"lgamma", HEADER_BIT(HEADER_MATH)},
+    {"llabs", HEADER_BIT(HEADER_STDLIB)},
+    {"lldiv", HEADER_BIT(HEADER_STDLIB)},
+    {"lldiv_t", HEADER_BIT(HEADER_STDLIB)},
+    {"llrint", HEADER_BIT(HEADER_MATH)},
+    {"llround", HEADER_BIT(HEADER_MATH)},
+    {"localeconv", HEADER_BIT(HEADER_LOCALE)},
+    {"localtime", HEADER_BIT(HEADER_TIME)},
+    {"localtime_r", HEADER_BIT(HEADER_TIME)},
+    {"log", HEADER_BIT(HEADER_MATH)},
+    {"log10", HEADER_BIT(HEADER_MATH)},
+    {"log1p", HEADER_BIT(HEADER_MATH)},
+    {"log2", HEADER_BIT(HEADER_MATH)},
+    {"logb", HEADER_BIT(HEADER_MATH)},
+    {"longjmp", HEADER_BIT(HEADER_SETJMP)},
+    {"lrint", HEADER_BIT(HEADER_MATH)},
+    {"lround", HEADER_BIT(HEADER_MATH)},
+    {"malloc", HEADER_BIT(HEADER_STDLIB)},
+    {"max_align_t", HEADER_BIT(HEADER_STDDEF)},
+    {"mblen", HEADER_BIT(HEADER_STDLIB)},
+    {"mbstowcs", HEADER_BIT(HEADER_STDLIB)},
+    {"mbtowc", HEADER_BIT(HEADER_STDLIB)},
+    {"mktime", HEADER_BIT(HEADER_TIME)},
+    {"modf", HEADER_BIT(HEADER_MATH)},
+    {"nan", HEADER_BIT(HEADER_MATH)},
+    {"nanosleep", HEADER_BIT(HEADER_TIME)},
+    {"nearbyint", HEADER_BIT(HEADER_MATH)},
+    {"nextafter", HEADER_BIT(HEADER_MATH)},
+    {"nexttoward", HEADER_BIT(HEADER_MATH)},
+    {"offsetof", HEADER_BIT(HEADER_STDDEF)},
+    {"pclose", HEADER_BIT(HEADER_STDIO)},
+    {"perror", HEADER_BIT(HEADER_STDIO)},
+    {"popen", HEADER_BIT(HEADER_STDIO)},
+    {"pow", HEADER_BIT(HEADER_MATH)},
+    {"printf", HEADER_BIT(HEADER_STDIO)},
+    {"ptrdiff_t", HEADER_BIT(HEADER_STDDEF)},
+    {"putc", HEADER_BIT(HEADER_STDIO)},
+    {"putchar", HEADER_BIT(HEADER_STDIO)},
+    {"puts", HEADER_BIT(HEADER_STDIO)},
+    {"qsort", HEADER_BIT(HEADER_STDLIB)},
+    {"quick_exit", HEADER_BIT(HEADER_STDLIB)},
+    {"raise", HEADER_BIT(HEADER_SIGNAL)},
+    {"rand", HEADER_BIT(HEADER_STDLIB)},
+    {"realloc", HEADER_BIT(HEADER_STDLIB)},
+    {"remainder", HEADER_BIT(HEADER_MATH)},
+    {"remove", HEADER_BIT(HEADER_STDIO)},
+    {"remquo", HEADER_BIT(HEADER_MATH)},
+    {"rename", HEADER_BIT(HEADER_STDIO)},
+    {"rewind", HEADER_BIT(HEADER_STDIO)},
+    {"rint", HEADER_BIT(HEADER_MATH)},
+    {"round", HEADER_BIT(HEADER_MATH)},
+    {"scalbln", HEADER_BIT(HEADER_MATH)},
+    {"scalbn", HEADER_BIT(HEADER_MATH)},
+    {"scanf", HEADER_BIT(HEADER_STDIO)},
+    {"setbuf", HEADER_BIT(HEADER_STDIO)},
+    {"setenv", HEADER_BIT(HEADER_STDLIB)},
+    {"setjmp", HEADER_BIT(HEADER_SETJMP)},
+    {"setlocale", HEADER_BIT(HEADER_LOCALE)},
+    {"setvbuf", HEADER_BIT(HEADER_STDIO)},
+    {"sig_atomic_t", HEADER_BIT(HEADER_SIGNAL)},
+    {"signal", HEADER_BIT(HEADER_SIGNAL)},
+    {"signbit", HEADER_BIT(HEADER_MATH)},
+    {"sin", HEADER_BIT(HEADER_MATH)},
+    {"sinh", HEADER_BIT(HEADER_MATH)},
+    {"size_t", HEADER_BIT(HEADER_STDDEF)},
+    {"snprintf", HEADER_BIT(HEADER_STDIO)},
+    {"sprintf", HEADER_BIT(HEADER_STDIO)},
+    {"sqrt", HEADER_BIT(HEADER_MATH)},
+    {"srand", HEADER_BIT(HEADER_STDLIB)},
+    {"sscanf", HEADER_BIT(HEADER_STDIO)},
+    {"static_assert", HEADER_BIT(HEADER_ASSERT)},
+    {"stderr", HEADER_BIT(HEADER_STDIO)},
+    {"stdin", HEADER_BIT(HEADER_STDIO)},
+    {"stdout", HEADER_BIT(HEADER_STDIO)},
+    {"strftime", HEADER_BIT(HEADER_TIME)},
+    {"strtod", HEADER_BIT(HEADER_STDLIB)},
+    {"strtof", HEADER_BIT(HEADER_STDLIB)},
+    {"strtol", HEADER_BIT(HEADER_STDLIB)},
+    {"strtold", HEADER_BIT(HEADER_STDLIB)},
+    {"strtoll", HEADER_BIT(HEADER_STDLIB)},
+    {"strtoul", HEADER_BIT(HEADER_STDLIB)},
+    {"strtoull", HEADER_BIT(HEADER_STDLIB)},
+    {"system", HEADER_BIT(HEADER_STDLIB)},
+    {"tan", HEADER_BIT(HEADER_MATH)},
+    {"tanh", HEADER_BIT(HEADER_MATH)},
+    {"tgamma", HEADER_BIT(HEADER_MATH)},
+    {"time", HEADER_BIT(HEADER_TIME)},
+    {"time_t", HEADER_BIT(HEADER_TIME)},
+    {"timespec", HEADER_BIT(HEADER_TIME)},
+    {"timespec_get", HEADER_BIT(HEADER_TIME)},
+    {"tm", HEADER_BIT(HEADER_TIME)},
+    {"tmpfile", HEADER_BIT(HEADER_STDIO)},
+    {"tmpnam", HEADER_BIT(HEADER_STDIO)},
+    {"tolower", HEADER_BIT(HEADER_CTYPE)},
+    {"toupper", HEADER_BIT(HEADER_CTYPE)},
+    {"trunc", HEADER_BIT(HEADER_MATH)},
+    {"ungetc", HEADER_BIT(HEADER_STDIO)},
+    {"unsetenv", HEADER_BIT(HEADER_STDLIB)},
+    {"vfprintf", HEADER_BIT(HEADER_STDIO)},
+    {"vfscanf", HEADER_BIT(HEADER_STDIO)},
+    {"vprintf", HEADER_BIT(HEADER_STDIO)},
+    {"vscanf", HEADER_BIT(HEADER_STDIO)},
+    {"vsnprintf", HEADER_BIT(HEADER_STDIO)},
+    {"vsprintf", HEADER_BIT(HEADER_STDIO)},
+    {"vsscanf", HEADER_BIT(HEADER_STDIO)},
+    {"wchar_t", HEADER_BIT(HEADER_STDDEF)},
+    {"wcstombs", HEADER_BIT(HEADER_STDLIB)},
+    {"wctomb", HEADER_BIT(HEADER_STDLIB)},
+};
+
+static int compare_name(const void *key, const void *entry)
+{
+    return strcmp(key, ((const KnownName *)entry)->name);
+}
+
+static unsigned lookup_name(const char *name)
+{
+    const KnownName *known = bsearch(name, known_names, sizeof(known_names) / sizeof(known_names[0]),
+                                     sizeof(KnownName), compare_name);
+    return known ? known->headers : 0;
+}
+
+static int is_upper_word(const char *name)
+{
+    for (const char *p = name; *p; p++)
+    {
+        if (!((*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9')))
+            return 0;
+    }
+    return 1;
+}
+
+// 一个标识符需要的头文件：先查表，再看成族出现的前缀
+static unsigned headers_for(const char *name, size_t length)
+{
+    unsigned headers = lookup_name(name);
+
+    // sinf/sinl这样的float/long double版本
+    if (length > 2 && (name[length - 1] == 'f' || name[length - 1] == 'l'))
+    {
+        char base[64];
+        memcpy(base, name, length - 1);
+        base[length - 1] = '\0';
+        if (lookup_name(base) & HEADER_BIT(HEADER_MATH))
+            headers |= HEADER_BIT(HEADER_MATH);
+    }
+
+    if (strncmp(name, "str", 3) == 0 || strncmp(name, "mem", 3) == 0)
+        headers |= HEADER_BIT(HEADER_STRING);
+    if (strncmp(name, "FLT_", 4) == 0 || strncmp(name, "DBL_", 4) == 0 || strncmp(name, "LDBL_", 5) == 0)
+        headers |= HEADER_BIT(HEADER_FLOAT);
+    if (strncmp(name, "SIG", 3) == 0)
+        headers |= HEADER_BIT(HEADER_SIGNAL);
+    if (strncmp(name, "LC_", 3) == 0)
+        headers |= HEADER_BIT(HEADER_LOCALE);
+    // EINVAL、ERANGE这样的错误码
+    if (name[0] == 'E' && length > 2 && is_upper_word(name))
+        headers |= HEADER_BIT(HEADER_ERRNO);
+    return headers;
+}
+
+// C关键字、预处理指令和编译器内建的名字，按strcmp的顺序排列
+static const char *const c_keywords[] = {
+    "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary", "_Noreturn",
+    "_Pragma", "_Static_assert", "_Thread_local", "__FILE__", "__LINE__", "__asm__", "__attribute__",
+    "__extension__", "__func__", "__inline__", "__restrict", "__typeof__", "auto", "break", "case",
+    "char", "const", "continue", "default", "define", "defined", "do", "double", "elif", "else",
+    "endif", "enum", "error", "extern", "float", "for", "goto", "if", "ifdef", "ifndef", "inline",
+    "int", "long", "pragma", "register", "restrict", "return", "short", "signed", "sizeof", "static",
+    "struct", "switch", "typedef", "typeof", "undef", "union", "unsigned", "void", "volatile", "while",
+};
+
+// 后面可以跟被声明的名字的关键字
+static const char *const c_type_keywords[] = {
+    "_Atomic", "_Bool", "_Complex", "_Thread_local", "auto", "char", "const", "double", "enum", "extern",
+    "float", "inline", "int", "long", "register", "restrict", "short", "signed", "static", "struct",
+    "typedef", "union", "unsigned", "void", "volatile",
+};
+
+static int compare_keyword(const void *key, const void *entry)
+{
+    return strcmp(key, *(const char *const *)entry);
+}
+
+static int is_keyword(const char *name)
+{
+    return bsearch(name, c_keywords, sizeof(c_keywords) / sizeof(c_keywords[0]), sizeof(c_keywords[0]),
+                   compare_keyword) != NULL;
+}
+
+static int is_type_keyword(const char *name)
+{
+    for (size_t i = 0; i < sizeof(c_type_keywords) / sizeof(c_type_keywords[0]); i++)
+    {
+        if (strcmp(name, c_type_keywords[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// 表里的类型名：FILE、jmp_buf和以_t结尾的
+static int is_known_type(const char *name, size_t length)
+{
+    if (!lookup_name(name))
+        return 0;
+    return strcmp(name, "FILE") == 0 || strcmp(name, "jmp_buf") == 0 ||
+           (length > 2 && name[length - 2] == '_' && name[length - 1] == 't');
+}
+
+static int is_c_ident_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int is_c_ident_char(char c)
+{
+    return is_c_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+// C前导代码自己声明的名字，指向前导代码里的原文
+typedef struct DeclaredName
+{
+    const char *start;
+    size_t length;
+    int is_type; // typedef出来的类型名
+} DeclaredName;
+
+typedef struct DeclaredSet
+{
+    DeclaredName *entries;
+    size_t count;
+    size_t capacity;
+} DeclaredSet;
+
+static DeclaredName *find_declared(const DeclaredSet *set, const char *start, size_t length)
+{
+    for (size_t i = set->count; i > 0; i--)
+    {
+        DeclaredName *entry = &set->entries[i - 1];
+        if (entry->length == length && memcmp(entry->start, start, length) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+static void declare(DeclaredSet *set, const char *start, size_t length, int is_type)
+{
+    DeclaredName *entry = find_declared(set, start, length);
+    if (entry)
+    {
+        entry->is_type |= is_type;
+        return;
+    }
+    if (set->count == set->capacity)
+    {
+        set->capacity = set->capacity ? set->capacity * 2 : 32;
+        set->entries = realloc(set->entries, set->capacity * sizeof(DeclaredName));
+        if (!set->entries)
+        {
+            fprintf(stderr, "Memory allocation failed in header scan\n");
+            exit(1);
+        }
+    }
+    set->entries[set->count++] = (DeclaredName){start, length, is_type};
+}
+
+// 跳过注释、字符串和字符常量，返回下一个要看的位置
+static const char *skip_literal(const char *p, const char *end)
+{
+    if (p + 1 < end && p[0] == '/' && p[1] == '/')
+    {
+        while (p < end && *p != '\n')
+            p++;
+        return p;
+    }
+    if (p + 1 < end && p[0] == '/' && p[1] == '*')
+    {
+        p += 2;
+        while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+            p++;
+        return p + 1 < end ? p + 2 : end;
+    }
+    char quote = *p++;
+    while (p < end && *p != quote && *p != '\n')
+        p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+    return p < end ? p + 1 : end;
+}
+
+// 上一个有意义的记号，决定下一个标识符是不是在被声明
+typedef enum PreviousToken
+{
+    PREVIOUS_OTHER,
+    PREVIOUS_TYPE,       // 类型关键字或类型名，后面的标识符是被声明的名字
+    PREVIOUS_TAG,        // struct/union/enum，后面是标签名
+    PREVIOUS_MEMBER,     // .或->，后面是成员名
+    PREVIOUS_DIRECTIVE,  // 行首的#
+    PREVIOUS_DEFINE,     // #define，后面是宏名
+    PREVIOUS_LABEL,      // goto，后面是标签名
+    PREVIOUS_ENUMERATOR, // enum {A, B}里的常量
+} PreviousToken;
+
+unsigned headers_used_by(const char *c_header, size_t length)
+{
+    unsigned headers = 0;
+    int complete = 1;
+    DeclaredSet declared = {NULL, 0, 0};
+    PreviousToken previous = PREVIOUS_OTHER;
+    int line_start = 1;
+    int depth = 0;
+    int declaring = 0, declaration_depth = 0, declaring_typedef = 0; // 正在一条声明里
+    int enum_pending = 0, enum_depth = -1;
+    const char *p = c_header;
+    const char *end = c_header + length;
+    while (p < end && complete)
+    {
+        char c = *p;
+        if (c == '\n')
+        {
+            line_start = 1;
+            if (previous == PREVIOUS_DIRECTIVE || previous == PREVIOUS_DEFINE)
+                previous = PREVIOUS_OTHER;
+            p++;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+        {
+            p++;
+            continue;
+        }
+        if (c == '"' || c == '\'' || (c == '/' && p + 1 < end && (p[1] == '/' || p[1] == '*')))
+        {
+            p = skip_literal(p, end);
+            line_start = 0;
+            continue;
+        }
+        if (c == '#' && line_start)
+        {
+            previous = PREVIOUS_DIRECTIVE;
+            line_start = 0;
+            p++;
+            continue;
+        }
+        line_start = 0;
+
+        if (!is_c_ident_start(c))
+        {
+            // 数字里的字母（0x1f、1e5）不是标识符
+            if (c >= '0' && c <= '9')
+            {
+                while (p < end && (is_c_ident_char(*p) || *p == '.'))
+                    p++;
+                previous = PREVIOUS_OTHER;
+                continue;
+            }
+            if (c == '(' || c == '[' || c == '{')
+            {
+                if (c == '{' && enum_pending)
+                    enum_depth = depth + 1;
+                enum_pending = 0;
+                depth++;
+            }
+            else if (c == ')' || c == ']' || c == '}')
+            {
+                if (depth == enum_depth)
+                    enum_depth = -1;
+                depth--;
+                if (declaring && depth < declaration_depth)
+                    declaring = 0;
+            }
+            else if (c == ';' && (!declaring || depth == declaration_depth))
+            {
+                declaring = 0;
+                enum_pending = 0;
+            }
+
+            if (c == '.' || (c == '-' && p + 1 < end && p[1] == '>'))
+            {
+                previous = PREVIOUS_MEMBER;
+                p += c == '.' ? 1 : 2;
+                continue;
+            }
+            // FILE *f里的星号不打断声明
+            if (c == '*' && previous == PREVIOUS_TYPE)
+            {
+                p++;
+                continue;
+            }
+            if ((c == ',' || c == '{') && depth == enum_depth)
+                previous = PREVIOUS_ENUMERATOR;
+            else if (declaring && depth == declaration_depth && (c == ',' || c == '}'))
+                previous = PREVIOUS_TYPE; // int a, b;和struct {...} s;
+            else
+                previous = PREVIOUS_OTHER;
+            p++;
+            continue;
+        }
+
+        const char *start = p;
+        while (p < end && is_c_ident_char(*p))
+            p++;
+        size_t word_length = p - start;
+        char word[64];
+        int short_word = word_length < sizeof(word);
+        if (short_word)
+        {
+            memcpy(word, start, word_length);
+            word[word_length] = '\0';
+        }
+
+        PreviousToken before = previous;
+        previous = PREVIOUS_OTHER;
+        if (before == PREVIOUS_DIRECTIVE)
+        {
+            // #include的名字来自用户自己的头文件，无法归类
+            if (short_word && strcmp(word, "include") == 0)
+                complete = 0;
+            else if (short_word && strcmp(word, "define") == 0)
+                previous = PREVIOUS_DEFINE;
+            continue;
+        }
+        // 成员名和goto的标签不需要头文件，enum常量记下来
+        if (before == PREVIOUS_MEMBER || before == PREVIOUS_LABEL)
+            continue;
+        if (before == PREVIOUS_ENUMERATOR)
+        {
+            declare(&declared, start, word_length, 0);
+            continue;
+        }
+
+        DeclaredName *known_declared = find_declared(&declared, start, word_length);
+        if (short_word && is_keyword(word))
+        {
+            if (is_type_keyword(word))
+            {
+                if (!declaring)
+                {
+                    declaring = 1;
+                    declaration_depth = depth;
+                    declaring_typedef = 0;
+                }
+                if (strcmp(word, "typedef") == 0)
+                    declaring_typedef = 1;
+                previous = PREVIOUS_TYPE;
+                if (strcmp(word, "struct") == 0 || strcmp(word, "union") == 0 || strcmp(word, "enum") == 0)
+                    previous = PREVIOUS_TAG;
+                if (strcmp(word, "enum") == 0)
+                    enum_pending = 1;
+            }
+            else if (strcmp(word, "goto") == 0)
+            {
+                previous = PREVIOUS_LABEL;
+            }
+            continue;
+        }
+        if (before == PREVIOUS_TAG)
+        {
+            declare(&declared, start, word_length, 0);
+            previous = PREVIOUS_TYPE;
+            continue;
+        }
+
+        unsigned needed = short_word ? headers_for(word, word_length) : 0;
+        headers |= needed;
+        int is_type = (short_word && is_known_type(word, word_length)) || (known_declared && known_declared->is_type);
+        if (is_type)
+        {
+            if (!declaring)
+            {
+                declaring = 1;
+                declaration_depth = depth;
+                declaring_typedef = 0;
+            }
+            previous = PREVIOUS_TYPE;
+            continue;
+        }
+        if (before == PREVIOUS_TYPE || before == PREVIOUS_DEFINE)
+        {
+            declare(&declared, start, word_length, before == PREVIOUS_TYPE && declaring_typedef);
+            continue;
+        }
+        // 标准库里的名字、HerCode函数和前面声明过的名字都算认识，其余的来历不明
+        if (!needed && !known_declared && !(word_length > 9 && memcmp(start, "function_", 9) == 0))
+            complete = 0;
+    }
+    free(declared.entries);
+    // 有认不出的名字就退回原来的全部头文件，免得漏掉它需要的声明
+    return complete ? headers : HEADER_ALL;
+}
@@ -0,0 +1,105 @@
+#include "hercode.h"
+#include "source.h"
+#include "lexer.h"
+#include "parser.h"
+#include "flat_ast.h"
+#include "codegen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct HercodeContext
+{
+    Arena arena; // 每次编译结束后reset，保留一块内存给下一次
+    FlatAST ast;
+    StrBuf c_code; // 生成的C代码，多次编译之间复用
+};
+
+HercodeContext *hercode_context_new(void)
+{
+    HercodeContext *context = malloc(sizeof(HercodeContext));
+    if (!context)
+        return NULL;
+    arena_init(&context->arena);
+    flat_ast_init(&context->ast);
+    strbuf_init(&context->c_code);
+    return context;
+}
+
+void hercode_context_free(HercodeContext *context)
+{
+    if (!context)
+        return;
+    flat_ast_free(&context->ast);
+    strbuf_free(&context->c_code);
+    arena_free(&context->arena);
+    free(context);
+}
+
+// 把内存流里的内容截断复制到调用者的缓冲区
+static void copy_out(const char *text, size_t length, char *buffer, size_t capacity)
+{
+    if (!buffer || capacity == 0)
+        return;
+    if (length >= capacity)
+        length = capacity - 1;
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+}
+
+HercodeStatus hercode_compile_to_c(HercodeContext *context,
+                                   const char *source, size_t source_length,
+                                   char *output, size_t output_capacity, size_t *output_length,
+                                   char *diagnostics, size_t diagnostics_capacity)
+{
+    char *diag_text = NULL;
+    size_t diag_length = 0;
+    FILE *diag = open_memstream(&diag_text, &diag_length);
+    if (!diag)
+        return HERCODE_ERROR_INTERNAL;
+
+    HercodeStatus status = HERCODE_OK;
+    *output_length = 0;
+
+    // 词法分析器依赖结尾的'\0'，调用者的缓冲区不一定有，复制一份到arena里
+    char *text = arena_strndup(&context->arena, source, source_length);
+
+    const char *c_header = NULL;
+    size_t c_header_length = 0;
+    const char *hercode_source = NULL;
+    separate_header(text, source_length, "Hello! Her World", &c_header, &c_header_length, &hercode_source);
+    if (hercode_source == NULL)
+        hercode_source = text;
+
+    InternTable strings;
+    intern_init(&strings, &context->arena);
+    Lexer *lexer = new_lexer(hercode_source);
+    Parser *parser = new_parser(lexer, &context->arena, &strings);
+    parser->diagnostics = diag;
+
+    int node_count;
+    ASTNode **nodes = parse_program(parser, &node_count);
+    if (!nodes)
+    {
+        status = HERCODE_ERROR_SYNTAX;
+    }
+    else
+    {
+        flatten_program(nodes, node_count, &context->ast);
+        strbuf_reset(&context->c_code);
+        generate_c_code(c_header, c_header_length, &context->ast, INCLUDE_USED, 1, &context->c_code);
+        *output_length = context->c_code.length;
+        if (!output || context->c_code.length >= output_capacity)
+            status = HERCODE_ERROR_OUTPUT_TOO_SMALL;
+        else
+            memcpy(output, context->c_code.data, context->c_code.length + 1);
+    }
+
+    fclose(diag);
+    copy_out(diag_text, diag_length, diagnostics, diagnostics_capacity);
+    free(diag_text);
+    free_parser(parser);
+    intern_free(&strings);
+    arena_reset(&context->arena);
+    return status;
+}
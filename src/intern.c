@@ -0,0 +1,105 @@
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a
+static uint32_t hash_bytes(const char *text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void intern_init(InternTable *table, Arena *arena)
+{
+    table->arena = arena;
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->allocations = 0;
+}
+
+// 字符串本身在arena里，这里只释放哈希表
+void intern_free(InternTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+static void grow(InternTable *table)
+{
+    uint32_t capacity = table->capacity ? table->capacity * 2 : 256;
+    InternEntry *entries = calloc(capacity, sizeof(InternEntry));
+    if (!entries)
+    {
+        fprintf(stderr, "Memory allocation failed for intern table\n");
+        exit(1);
+    }
+    table->allocations++;
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = 0; i < table->capacity; i++)
+    {
+        InternEntry *old = &table->entries[i];
+        if (!old->text)
+            continue;
+        uint32_t slot = old->hash & mask;
+        while (entries[slot].text)
+            slot = (slot + 1) & mask;
+        entries[slot] = *old;
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+// 找到text所在的槽，或者它应该插入的空槽
+static uint32_t find_slot(const InternTable *table, const char *text, size_t length, uint32_t hash)
+{
+    uint32_t mask = table->capacity - 1;
+    uint32_t slot = hash & mask;
+    while (table->entries[slot].text)
+    {
+        const char *existing = table->entries[slot].text;
+        if (table->entries[slot].hash == hash && intern_length(existing) == length &&
+            memcmp(existing, text, length) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+const char *intern(InternTable *table, const char *text, size_t length)
+{
+    if ((table->count + 1) * 2 > table->capacity)
+        grow(table);
+
+    uint32_t hash = hash_bytes(text, length);
+    uint32_t slot = find_slot(table, text, length, hash);
+    if (table->entries[slot].text)
+        return table->entries[slot].text;
+
+    InternHeader *header = arena_alloc(table->arena, sizeof(InternHeader) + length + 1);
+    header->id = table->count++;
+    header->length = (uint32_t)length;
+    char *copy = (char *)(header + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    table->entries[slot].text = copy;
+    table->entries[slot].hash = hash;
+    return copy;
+}
+
+const char *intern_lookup(const InternTable *table, const char *text, size_t length)
+{
+    if (table->capacity == 0)
+        return NULL;
+    return table->entries[find_slot(table, text, length, hash_bytes(text, length))].text;
+}
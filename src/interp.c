@@ -0,0 +1,109 @@
+#include "interp.h"
+#include "codegen.h"
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 一层调用：正在执行的语句序列和下一条语句的位置
+typedef struct Frame
+{
+    ASTNode **body;
+    int count;
+    int next;
+} Frame;
+
+static void say(const ASTNode *node, int in_main, StrBuf *scratch, FILE *out)
+{
+    size_t length = intern_length(node->value);
+    if (in_main && memchr(node->value, '\\', length))
+    {
+        strbuf_reset(scratch);
+        decode_c_literal(node->value, length, scratch);
+        fwrite(scratch->data, 1, scratch->length, out);
+    }
+    else
+    {
+        fwrite(node->value, 1, length, out);
+    }
+    putc('\n', out);
+}
+
+int run_program(ASTNode **nodes, int count, const SymbolTable *functions, FILE *out, FILE *diagnostics)
+{
+    int capacity = 64;
+    Frame *stack = malloc(capacity * sizeof(Frame));
+    if (!stack)
+    {
+        fprintf(diagnostics, "Memory allocation failed\n");
+        return 1;
+    }
+    StrBuf scratch;
+    strbuf_init(&scratch);
+
+    // 第0层是main：顶层除函数定义以外的语句
+    int depth = 1;
+    stack[0].body = nodes;
+    stack[0].count = count;
+    stack[0].next = 0;
+    int status = 0;
+    while (depth > 0)
+    {
+        Frame *frame = &stack[depth - 1];
+        if (frame->next == frame->count)
+        {
+            depth--;
+            continue;
+        }
+        ASTNode *node = frame->body[frame->next++];
+        if (node->type == STMT_SAY)
+        {
+            say(node, depth == 1, &scratch, out);
+            continue;
+        }
+        if (node->type != STMT_FUNCTION_CALL)
+            continue;
+
+        ASTNode *target = node->target;
+        if (!target)
+        {
+            const FunctionDef *def = find_function(functions, node->value);
+            target = def ? def->node : NULL;
+        }
+        if (!target)
+        {
+            fprintf(diagnostics, "Error: call to undefined function '%s'\n", node->value);
+            status = 1;
+            break;
+        }
+        // 尾调用直接复用当前这一层，和gcc -O2的尾调用优化一样，尾递归不会越积越深
+        if (frame->next == frame->count && depth > 1)
+            depth--;
+        if (depth >= INTERP_MAX_DEPTH)
+        {
+            fprintf(diagnostics, "Error: call stack overflow in function '%s'\n", target->value);
+            status = 1;
+            break;
+        }
+        if (depth == capacity)
+        {
+            capacity *= 2;
+            Frame *new_stack = realloc(stack, capacity * sizeof(Frame));
+            if (!new_stack)
+            {
+                fprintf(diagnostics, "Memory allocation failed\n");
+                status = 1;
+                break;
+            }
+            stack = new_stack;
+        }
+        stack[depth].body = target->body;
+        stack[depth].count = target->body_count;
+        stack[depth].next = 0;
+        depth++;
+    }
+
+    fflush(out);
+    strbuf_free(&scratch);
+    free(stack);
+    return status;
+}
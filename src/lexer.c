@@ -1,45 +1,110 @@
 #include "lexer.h"
-#include <ctype.h>
+#include "scan.h"
+#include "trace.h"
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-Lexer *new_lexer(char *source)
+Lexer *new_lexer(const char *source)
 {
     Lexer *lexer = malloc(sizeof(Lexer));
     lexer->source = source;
     lexer->pos = 0;
     lexer->current_char = source[0];
     lexer->current_indent = 0;
+    lexer->indent_capacity = 16;
+    lexer->indent_stack = malloc(lexer->indent_capacity * sizeof(int));
     lexer->indent_stack[0] = 0; // 初始化缩进栈（第0级=0）
     lexer->indent_top = 0;
     lexer->pending_dedents = 0;
     return lexer;
 }
 
-void advance(Lexer *lexer)
+void free_lexer(Lexer *lexer)
+{
+    free(lexer->indent_stack);
+    free(lexer);
+}
+
+static void advance(Lexer *lexer)
 {
     lexer->pos++;
     lexer->current_char = lexer->source[lexer->pos];
 }
 
-Token *new_token(TokenType type, const char *value)
+// 直接跳到指定位置，用于扫描函数一次跨过多个字节
+static void advance_to(Lexer *lexer, const char *p)
+{
+    lexer->pos = (int)(p - lexer->source);
+    lexer->current_char = *p;
+}
+
+// 只认ASCII字母，不依赖locale
+static int is_ident_start(char c)
+{
+    return (unsigned)((c | 0x20) - 'a') < 26;
+}
+
+static int is_ident_char(char c)
+{
+    return is_ident_start(c) || (unsigned)(c - '0') < 10 || c == '_';
+}
+
+// 关键字表：新增关键字只需在这里加一行（关键字，首字母，末字母，token类型）
+#define HERCODE_KEYWORDS(X)                 \
+    X("say", 's', 'y', TOKEN_SAY)           \
+    X("start", 's', 't', TOKEN_START)       \
+    X("function", 'f', 'n', TOKEN_FUNCTION) \
+    X("end", 'e', 'd', TOKEN_END)
+
+// 由长度和首末字母组成的完美哈希；哈希冲突会变成重复的case标签，在编译期报错
+#define KEYWORD_HASH(length, first, last) \
+    ((((unsigned)(length) * 7u) + ((unsigned char)(first) * 3u) + (unsigned char)(last)) & 63u)
+
+// 直接在源码切片上识别关键字，不复制
+static TokenType lookup_keyword(const char *word, int length)
+{
+    switch (KEYWORD_HASH(length, word[0], word[length - 1]))
+    {
+#define KEYWORD_CASE(text, first, last, type)                              \
+    case KEYWORD_HASH(sizeof(text) - 1, first, last):                      \
+        if (length == sizeof(text) - 1 && memcmp(word, text, length) == 0) \
+            return type;                                                   \
+        break;
+        HERCODE_KEYWORDS(KEYWORD_CASE)
+#undef KEYWORD_CASE
+    default:
+        break;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+// 构造一个指向源码切片的token，不做任何堆分配
+static Token make_token(TokenType type, int start, int length)
 {
-    Token *token = malloc(sizeof(Token));
-    token->type = type;
-    token->value = value ? strdup(value) : NULL; // 允许NULL值
+    Token token;
+    token.type = type;
+    token.start = start;
+    token.length = length;
     return token;
 }
-Token *next_token(Lexer *lexer)
+
+const char *token_text(const Lexer *lexer, Token token)
+{
+    return lexer->source + token.start;
+}
+
+Token next_token(Lexer *lexer)
 {
-    printf("Current char: %c, pos: %d\n", lexer->current_char, lexer->pos);
+    TRACE(TRACE_LEXER, "[LEXER] Current char: %c, pos: %d\n", lexer->current_char, lexer->pos);
 
     // 处理待生成的DEDENT
     if (lexer->pending_dedents > 0)
     {
         lexer->pending_dedents--;
-        printf("[LEXER] Generating pending DEDENT (%d left)\n", lexer->pending_dedents);
-        return new_token(TOKEN_DEDENT, NULL);
+        TRACE(TRACE_LEXER, "[LEXER] Generating pending DEDENT (%d left)\n", lexer->pending_dedents);
+        return make_token(TOKEN_DEDENT, lexer->pos, 0);
     }
 
     // 处理文件结束情况
@@ -48,24 +113,22 @@ Token *next_token(Lexer *lexer)
         // 文件结束时处理剩余缩进
         if (lexer->indent_top > 0)
         {
-            printf("[LEXER] End of file, generating DEDENT for remaining indent\n");
+            TRACE(TRACE_LEXER, "[LEXER] End of file, generating DEDENT for remaining indent\n");
             lexer->indent_top--;
             lexer->pending_dedents = lexer->indent_top;
-            return new_token(TOKEN_DEDENT, NULL);
+            return make_token(TOKEN_DEDENT, lexer->pos, 0);
         }
-        printf("[LEXER] End of file, returning EOF token\n");
-        return new_token(TOKEN_EOF, NULL);
+        TRACE(TRACE_LEXER, "[LEXER] End of file, returning EOF token\n");
+        return make_token(TOKEN_EOF, lexer->pos, 0);
     }
 
     while (lexer->current_char != '\0')
     {
         if (lexer->current_char == '#')
         {
-            while (lexer->current_char != '\n' && lexer->current_char != '\0')
-            {
-                advance(lexer);
-            }
-            printf("[LEXER] Skipped a comment\n");
+            // 直接跳到行尾，不逐字节advance
+            advance_to(lexer, scan_until(lexer->source + lexer->pos, '\n', '\n'));
+            TRACE(TRACE_LEXER, "[LEXER] Skipped a comment\n");
             continue; // 跳过注释后继续处理其他token
         }
         // 处理单字符分隔符
@@ -73,74 +136,59 @@ Token *next_token(Lexer *lexer)
         {
         case ':': // 冒号
             advance(lexer);
-            return new_token(TOKEN_COLON, ":");
+            return make_token(TOKEN_COLON, lexer->pos - 1, 1);
         case ';': // 分号（如果需要）
             advance(lexer);
-            return new_token(TOKEN_SEMI, ";");
+            return make_token(TOKEN_SEMI, lexer->pos - 1, 1);
         case '\n': // 换行符（已经处理，但为了完整）
             return handle_newline_and_indent(lexer);
         default:
             break;
         }
 
-        if (isspace(lexer->current_char))
+        if (lexer->current_char == ' ' || lexer->current_char == '\t' || lexer->current_char == '\r' ||
+            lexer->current_char == '\v' || lexer->current_char == '\f')
         {
-            advance(lexer);
+            advance_to(lexer, skip_blanks(lexer->source + lexer->pos));
             continue;
         }
 
-        if (isalpha(lexer->current_char))
+        if (is_ident_start(lexer->current_char))
         {
-            char buffer[256];
-            int i = 0;
+            int start = lexer->pos;
             // 允许字母、数字和下划线
-            while (isalnum(lexer->current_char) || lexer->current_char == '_')
-            {
-                if (i < 255)
-                {
-                    buffer[i++] = lexer->current_char;
-                    advance(lexer);
-                }
-                else
-                    // 标识符太长，跳过剩余部分
-                    advance(lexer);
-            }
-            buffer[i] = '\0';
-            printf("Identifier: %s\n", buffer);
-            if (strcmp(buffer, "say") == 0)
-                return new_token(TOKEN_SAY, "say");
-            if (strcmp(buffer, "start") == 0 && lexer->current_char == ':')
+            const char *p = lexer->source + start;
+            while (is_ident_char(*p))
+                p++;
+            advance_to(lexer, p);
+            int length = lexer->pos - start;
+            const char *word = lexer->source + start;
+            TRACE(TRACE_LEXER, "[LEXER] Identifier: %.*s\n", length, word);
+            TokenType type = lookup_keyword(word, length);
+            if (type == TOKEN_START)
             {
+                // start 只有紧跟冒号时才是关键字
+                if (lexer->current_char != ':')
+                    return make_token(TOKEN_IDENTIFIER, start, length);
                 advance(lexer);
-                return new_token(TOKEN_START, "start:");
+                return make_token(TOKEN_START, start, length + 1);
             }
-            // 检查函数关键字
-            if (strcmp(buffer, "function") == 0)
-                return new_token(TOKEN_FUNCTION, "function");
-            if (strcmp(buffer, "end") == 0)
-                return new_token(TOKEN_END, "end");
-            return new_token(TOKEN_IDENTIFIER, buffer);
+            return make_token(type, start, length);
         }
 
         if (lexer->current_char == '"')
         {
             advance(lexer);
-            char buffer[256];
-            int i = 0;
-            while (lexer->current_char != '"' && lexer->current_char != '\0')
-            {
-                buffer[i++] = lexer->current_char;
-                advance(lexer);
-            }
+            int start = lexer->pos;
+            advance_to(lexer, scan_until(lexer->source + start, '"', '"'));
+            int length = lexer->pos - start;
             if (lexer->current_char == '"')
                 advance(lexer);
-            buffer[i] = '\0';
-            return new_token(TOKEN_STRING, buffer);
+            return make_token(TOKEN_STRING, start, length);
         }
 
-        Token *unknown = new_token(TOKEN_UNKNOWN, (char[]){lexer->current_char, '\0'});
         advance(lexer);
-        return unknown;
+        return make_token(TOKEN_UNKNOWN, lexer->pos - 1, 1);
     }
 
     // 文件结束时处理剩余缩进
@@ -148,13 +196,13 @@ Token *next_token(Lexer *lexer)
     {
         lexer->indent_top--;
         lexer->pending_dedents = lexer->indent_top;
-        return new_token(TOKEN_DEDENT, NULL);
+        return make_token(TOKEN_DEDENT, lexer->pos, 0);
     }
-    return new_token(TOKEN_EOF, "");
+    return make_token(TOKEN_EOF, lexer->pos, 0);
 }
 
 // 处理换行和缩进
-Token *handle_newline_and_indent(Lexer *lexer)
+Token handle_newline_and_indent(Lexer *lexer)
 {
     // 跳过当前换行符
     if (lexer->current_char == '\n')
@@ -165,8 +213,8 @@ Token *handle_newline_and_indent(Lexer *lexer)
     // 检查是否到达EOF
     if (lexer->current_char == '\0')
     {
-        printf("[LEXER] End of file after newline, no token generated\n");
-        return NULL;
+        TRACE(TRACE_LEXER, "[LEXER] End of file after newline, returning EOF token\n");
+        return make_token(TOKEN_EOF, lexer->pos, 0);
     }
 
     int new_indent = 0;
@@ -180,20 +228,20 @@ Token *handle_newline_and_indent(Lexer *lexer)
         // 检查是否到达行尾或文件尾
         if (lexer->current_char == '\0')
         {
-            printf("[LEXER] End of file during indentation calculation, no token generated\n");
-            return NULL;
+            TRACE(TRACE_LEXER, "[LEXER] End of file during indentation calculation, returning EOF token\n");
+            return make_token(TOKEN_EOF, lexer->pos, 0);
         }
     }
 
     // 添加调试信息
-    printf("[LEXER] Newline: new_indent=%d, current_indent_stack=%d\n",
-           new_indent, lexer->indent_stack[lexer->indent_top]);
+    TRACE(TRACE_LEXER, "[LEXER] Newline: new_indent=%d, current_indent_stack=%d\n",
+          new_indent, lexer->indent_stack[lexer->indent_top]);
 
     // 如果遇到连续换行符或文件结束
     if (lexer->current_char == '\n' || lexer->current_char == '\0')
     {
-        printf("[LEXER] Newline without content, returning NEWLINE token\n");
-        return new_token(TOKEN_NEWLINE, NULL);
+        TRACE(TRACE_LEXER, "[LEXER] Newline without content, returning NEWLINE token\n");
+        return make_token(TOKEN_NEWLINE, lexer->pos, 0);
     }
 
     int current_indent = lexer->indent_stack[lexer->indent_top];
@@ -202,8 +250,20 @@ Token *handle_newline_and_indent(Lexer *lexer)
     if (new_indent > current_indent)
     {
         lexer->indent_top++;
+        if (lexer->indent_top >= lexer->indent_capacity)
+        {
+            lexer->indent_capacity *= 2;
+            int *new_stack = realloc(lexer->indent_stack, lexer->indent_capacity * sizeof(int));
+            if (!new_stack)
+            {
+                fprintf(stderr, "Memory reallocation failed for indent stack\n");
+                exit(1);
+            }
+            lexer->indent_stack = new_stack;
+        }
         lexer->indent_stack[lexer->indent_top] = new_indent;
-        return new_token(TOKEN_INDENT, NULL);
+        // INDENT的切片就是行首的空白，长度即缩进量
+        return make_token(TOKEN_INDENT, lexer->pos - new_indent, new_indent);
     }
     else if (new_indent < current_indent)
     {
@@ -224,10 +284,57 @@ Token *handle_newline_and_indent(Lexer *lexer)
             lexer->pending_dedents = levels_to_dedent - 1;
         }
 
-        return new_token(TOKEN_DEDENT, NULL);
+        return make_token(TOKEN_DEDENT, lexer->pos, 0);
     }
     else
     {
-        return new_token(TOKEN_NEWLINE, NULL);
+        return make_token(TOKEN_NEWLINE, lexer->pos, 0);
+    }
+}
+
+// 把剩余源码全部切分成token，数组最后一个元素总是TOKEN_EOF
+void tokenize(Lexer *lexer, TokenArray *array)
+{
+    array->count = 0;
+    array->capacity = 256;
+    array->tokens = malloc(array->capacity * sizeof(Token));
+    if (!array->tokens)
+    {
+        fprintf(stderr, "Memory allocation failed for token array\n");
+        exit(1);
+    }
+
+    while (1)
+    {
+        if (array->count >= array->capacity)
+        {
+            // 翻倍后的字节数不能溢出size_t
+            if (array->capacity > SIZE_MAX / 2 / sizeof(Token))
+            {
+                fprintf(stderr, "Too many tokens: %zu\n", array->count);
+                exit(1);
+            }
+            array->capacity *= 2;
+            Token *new_tokens = realloc(array->tokens, array->capacity * sizeof(Token));
+            if (!new_tokens)
+            {
+                fprintf(stderr, "Memory reallocation failed for token array\n");
+                exit(1);
+            }
+            array->tokens = new_tokens;
+        }
+
+        Token token = next_token(lexer);
+        array->tokens[array->count++] = token;
+        if (token.type == TOKEN_EOF)
+            break;
     }
-}
\ No newline at end of file
+}
+
+void free_token_array(TokenArray *array)
+{
+    free(array->tokens);
+    array->tokens = NULL;
+    array->count = 0;
+    array->capacity = 0;
+}
@@ -1,155 +1,282 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "lexer.h"
-#include "parser.h"
-#include "codegen.h"
-#include "ast.h"
+#include <unistd.h>
+#include "driver.h"
+#include "trace.h"
+#include "report.h"
+#include "optimize.h"
 
-char *read_file(const char *filename)
+static void usage(const char *program)
 {
-    FILE *file = fopen(filename, "rb");
-    if (!file)
-    {
-        perror("File opening failed");
-        return NULL;
-    }
-
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    char *buffer = malloc(size + 1);
-    fread(buffer, 1, size, file);
-    buffer[size] = '\0';
-    fclose(file);
-    return buffer;
+    fprintf(stderr, "Usage: %s [options] <source_file> [output_name]\n"
+            "       %s [--trace=...] [--time-report[=json]] [--no-cache] --run <source_file|file.hcb>\n"
+            "       %s [options] [-jN] --batch <source_file>...\n"
+            "       %s [options] [-jN] --manifest=<file>\n"
+            "Options: --trace=lexer,parser,driver  --time-report[=json]  --emit-c=file.c\n"
+            "         --backend=gcc|native|bytecode  --no-cache  --cache-dir=dir  --pch\n"
+            "         --keep-unused-functions  --print-removed-functions  --inline-limit=N (0: off)\n"
+            "         --no-precompute\n",
+            program, program, program, program);
 }
 
-void separate_header(const char *source, const char *magic_string,
-                     char **c_header, char **hercode_source)
+// 批量模式下由输入名推出输出名：去掉.hercode后缀，没有这个后缀就加上.out
+static char *default_output_name(const char *input_name)
 {
-    *c_header = NULL;
-    *hercode_source = NULL;
-
-    char *magic_pos = strstr(source, magic_string);
-    if (magic_pos == NULL)
+    size_t length = strlen(input_name);
+    const char *suffix = ".hercode";
+    size_t suffix_length = strlen(suffix);
+    char *output = malloc(length + 5);
+    if (!output)
     {
-        return; // 没有找到特殊字符串
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
     }
+    if (length > suffix_length && strcmp(input_name + length - suffix_length, suffix) == 0)
+        sprintf(output, "%.*s", (int)(length - suffix_length), input_name);
+    else
+        sprintf(output, "%s.out", input_name);
+    return output;
+}
 
-    // 确保特殊字符串在行首
-    if (magic_pos != source)
+static void add_job(BuildJob **jobs, int *count, int *capacity, const char *input_name, const char *output_name)
+{
+    if (*count >= *capacity)
     {
-        char *prev_char = magic_pos - 1;
-        if (*prev_char != '\n' && *prev_char != '\r')
+        *capacity = *capacity ? *capacity * 2 : 16;
+        BuildJob *new_jobs = realloc(*jobs, *capacity * sizeof(BuildJob));
+        if (!new_jobs)
         {
-            return; // 不在行首
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
         }
+        *jobs = new_jobs;
     }
-
-    // 查找行结束位置
-    char *line_end = strchr(magic_pos, '\n');
-    if (line_end == NULL)
+    // 任务里的名字都复制一份，结束时统一释放
+    BuildJob *job = &(*jobs)[(*count)++];
+    job->input_name = strdup(input_name);
+    job->output_name = output_name ? strdup(output_name) : default_output_name(input_name);
+    if (!job->input_name || !job->output_name)
     {
-        // 如果没有换行符，特殊字符串后没有内容
-        size_t header_size = magic_pos - source;
-        *c_header = malloc(header_size + 1);
-        if (*c_header)
-        {
-            strncpy(*c_header, source, header_size);
-            (*c_header)[header_size] = '\0';
-        }
-        *hercode_source = ""; // 空字符串
-        return;
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
     }
+}
 
-    // 计算C头部分的大小
-    size_t header_size = magic_pos - source;
-    *c_header = malloc(header_size + 1);
-    if (*c_header)
+static void free_jobs(BuildJob *jobs, int count)
+{
+    for (int i = 0; i < count; i++)
     {
-        strncpy(*c_header, source, header_size);
-        (*c_header)[header_size] = '\0';
+        free((char *)jobs[i].input_name);
+        free((char *)jobs[i].output_name);
     }
+    free(jobs);
+}
 
-    // HerCode部分从下一行开始
-    *hercode_source = line_end + 1;
-
-    // 特殊处理CRLF换行
-    if (*line_end == '\n' && line_end > magic_pos && *(line_end - 1) == '\r')
+// 清单文件每行一个任务："输入 [输出]"，空行和#开头的行忽略
+static int read_manifest(const char *path, BuildJob **jobs, int *count, int *capacity)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "Error reading manifest: %s\n", path);
+        return -1;
+    }
+    char *line = NULL;
+    size_t line_capacity = 0;
+    while (getline(&line, &line_capacity, file) >= 0)
     {
-        // 如果前面有CR，跳过它
-        *hercode_source = line_end;
+        char *save;
+        char *input = strtok_r(line, " \t\r\n", &save);
+        if (!input || input[0] == '#')
+            continue;
+        char *output = strtok_r(NULL, " \t\r\n", &save);
+        add_job(jobs, count, capacity, input, output);
     }
+    free(line);
+    fclose(file);
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    const char *positionals[argc]; // 位置参数不会多于argc个
+    int positional = 0;
+    int time_report = 0; // 0: 关闭，1: 文本，2: JSON
+    DriverOptions options = {NULL, 1, NULL, 0, BACKEND_GCC, 0, 0, INLINE_DEFAULT_LIMIT, 1};
+    int batch = 0;
+    int run = 0;
+    const char *manifest = NULL;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_backends = cores > 0 ? (int)cores : 1;
+    BuildJob *jobs = NULL;
+    int job_count = 0, job_capacity = 0;
+    for (int i = 1; i < argc; i++)
     {
-        fprintf(stderr, "Usage: %s <source_file> [output_name]\n", argv[0]);
-        return 1;
+        if (strncmp(argv[i], "--trace=", 8) == 0)
+        {
+#ifndef HERCODE_TRACE
+            fprintf(stderr, "Warning: tracing is not compiled into this build\n");
+#endif
+            if (trace_enable(argv[i] + 8) != 0)
+                return 1;
+        }
+        else if (strcmp(argv[i], "--time-report") == 0)
+        {
+            time_report = 1;
+        }
+        else if (strcmp(argv[i], "--time-report=json") == 0)
+        {
+            time_report = 2;
+        }
+        else if (strncmp(argv[i], "--emit-c=", 9) == 0)
+        {
+            options.emit_c = argv[i] + 9;
+        }
+        else if (strcmp(argv[i], "--no-cache") == 0)
+        {
+            options.use_cache = 0;
+        }
+        else if (strncmp(argv[i], "--cache-dir=", 12) == 0)
+        {
+            options.cache_dir = argv[i] + 12;
+        }
+        else if (strcmp(argv[i], "--pch") == 0)
+        {
+            options.pch = 1;
+        }
+        else if (strcmp(argv[i], "--backend=gcc") == 0)
+        {
+            options.backend = BACKEND_GCC;
+        }
+        else if (strcmp(argv[i], "--backend=native") == 0)
+        {
+            options.backend = BACKEND_NATIVE;
+        }
+        else if (strcmp(argv[i], "--backend=bytecode") == 0)
+        {
+            options.backend = BACKEND_BYTECODE;
+        }
+        else if (strcmp(argv[i], "--keep-unused-functions") == 0)
+        {
+            options.keep_unused = 1;
+        }
+        else if (strcmp(argv[i], "--print-removed-functions") == 0)
+        {
+            options.print_removed = 1;
+        }
+        else if (strcmp(argv[i], "--no-precompute") == 0)
+        {
+            options.precompute = 0;
+        }
+        else if (strncmp(argv[i], "--inline-limit=", 15) == 0)
+        {
+            char *end;
+            long limit = strtol(argv[i] + 15, &end, 10);
+            if (end == argv[i] + 15 || *end || limit < 0 || limit > 1 << 20)
+            {
+                fprintf(stderr, "Invalid inline limit: %s\n", argv[i] + 15);
+                return 1;
+            }
+            options.inline_limit = (int)limit;
+        }
+        else if (strcmp(argv[i], "--run") == 0)
+        {
+            run = 1;
+        }
+        else if (strcmp(argv[i], "--batch") == 0)
+        {
+            batch = 1;
+        }
+        else if (strncmp(argv[i], "--manifest=", 11) == 0)
+        {
+            manifest = argv[i] + 11;
+            batch = 1;
+        }
+        else if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            const char *value = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+            max_backends = atoi(value);
+            if (max_backends < 1)
+            {
+                fprintf(stderr, "Invalid job count: %s\n", value);
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            positionals[positional++] = argv[i];
+        }
     }
 
-    // 读取整个文件
-    char *source = read_file(argv[1]);
-    if (!source)
+    if (batch && run)
     {
-        fprintf(stderr, "Error reading file: %s\n", argv[1]);
+        fprintf(stderr, "--run only works with a single input\n");
         return 1;
     }
-
-    // 尝试分离C头部分
-    char *c_header = NULL;
-    char *hercode_source = NULL;
-    separate_header(source, "Hello! Her World", &c_header, &hercode_source);
-    printf("C Code:\n%s\n", c_header);
-    // 验证分离结果
-    if (hercode_source == NULL)
-        hercode_source = source; // 如果分离失败，使用整个文件
-
-    // 输出分离结果用于调试
-    printf("HerCode Source to Parse:\n%s\n", hercode_source);
-
-    // 创建词法分析器和解析器
-    Lexer *lexer = new_lexer(hercode_source);
-    Parser *parser = new_parser(lexer);
-
-    // 解析程序
-    int node_count;
-    ASTNode **nodes = parse_program(parser, &node_count);
-    printf("Parsed %d nodes\n", node_count);
-
-    // 生成C代码
-    FILE *c_file = fopen("temp.c", "w");
-    if (!c_file)
+    if (batch)
     {
-        perror("Error creating C file");
-        return 1;
+        // 批量模式下各任务同时进行，单个任务的报告和C代码输出没有意义
+        if (time_report || options.emit_c)
+        {
+            fprintf(stderr, "--time-report and --emit-c only work with a single input\n");
+            return 1;
+        }
+        // 批量模式下所有位置参数都是输入
+        for (int i = 0; i < positional; i++)
+            add_job(&jobs, &job_count, &job_capacity, positionals[i], NULL);
+        if (manifest && read_manifest(manifest, &jobs, &job_count, &job_capacity) != 0)
+        {
+            free_jobs(jobs, job_count);
+            return 1;
+        }
+        if (job_count == 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        // 前端很快，线程数按核数开；-j再大也要有足够的线程去等gcc
+        int workers = cores > max_backends ? (int)cores : max_backends;
+        int failures = build_batch(&options, jobs, job_count, workers, max_backends);
+        free_jobs(jobs, job_count);
+        return failures ? 1 : 0;
     }
-    generate_c_code(c_header, nodes, node_count, c_file);
-    fclose(c_file);
 
-    // 编译
-    char output_name[256] = "a.out";
-    if (argc >= 3)
+    if (positional == 0)
     {
-        strncpy(output_name, argv[2], sizeof(output_name) - 1);
+        usage(argv[0]);
+        return 1;
     }
-    compile("temp.c", output_name);
-
-    // 清理
-    if (c_header)
-        free(c_header);
-    free(source);
-    free_parser(parser);
+    const char *input_name = positionals[0];
 
-    for (int i = 0; i < node_count; i++)
+    if (run)
     {
-        free_node(nodes[i]);
+        // 解释执行时程序的输出在stdout上，报告仍然写到stderr
+        TimeReport report;
+        report_init(&report);
+        report_begin(&report);
+        int status = run_file(&options, input_name, stderr, &report);
+        if (time_report)
+            report_print(&report, stderr, time_report == 2);
+        return status;
     }
-    free(nodes);
 
+    const char *output_name = positional > 1 ? positionals[1] : "a.out";
+
+    TimeReport report;
+    report_init(&report);
+    report_begin(&report);
+    int status = build_file(&options, input_name, output_name, stderr, &report);
+    if (time_report)
+        report_print(&report, stderr, time_report == 2);
+    if (status != 0)
+        return status;
     printf("Successfully generated: %s\n", output_name);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,271 @@
+#include "native.h"
+#include "codegen.h"
+#include <elf.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NATIVE_BASE 0x400000u
+#define HEADERS_SIZE (sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr))
+
+// 指令长度固定，第一遍就能算出每个函数的地址
+#define SAY_SIZE 33        // mov eax,1; mov edi,1; lea rsi,[rip+x]; mov edx,n; syscall; test rax,rax; js rel32
+#define CALL_SIZE 5        // call rel32
+#define RET_SIZE 1         // ret
+#define EXIT_SIZE 9        // mov eax,231; xor edi,edi; syscall
+#define WRITE_ERROR_SIZE 12 // mov eax,231; mov edi,1; syscall
+
+typedef struct NativeFunction
+{
+    uint32_t name;   // 名字在字符串池中的偏移，驻留过的名字偏移相同
+    uint32_t offset; // 代码在代码段中的偏移
+} NativeFunction;
+
+typedef struct NativeWriter
+{
+    const FlatAST *ast;
+    StrBuf code;
+    StrBuf extra;           // 需要按C转义规则解码的字符串，放在字符串池后面
+    NativeFunction *functions;
+    uint32_t function_count;
+    uint32_t write_error;   // write失败时跳到的退出代码在代码段中的偏移
+    uint64_t code_address;  // 代码段的虚拟地址
+    uint64_t pool_address;  // 字符串池的虚拟地址
+    uint64_t extra_address;
+} NativeWriter;
+
+static int compare_function(const void *a, const void *b)
+{
+    uint32_t x = ((const NativeFunction *)a)->name, y = ((const NativeFunction *)b)->name;
+    return (x > y) - (x < y);
+}
+
+static uint32_t function_offset(const NativeWriter *writer, uint32_t name)
+{
+    NativeFunction key = {name, 0};
+    const NativeFunction *found = bsearch(&key, writer->functions, writer->function_count,
+                                          sizeof(NativeFunction), compare_function);
+    // 语法分析已经保证调用的函数都存在
+    return found ? found->offset : 0;
+}
+
+static void put_u8(StrBuf *code, uint8_t value)
+{
+    strbuf_append(code, (const char *)&value, 1);
+}
+
+static void put_u32(StrBuf *code, uint32_t value)
+{
+    uint8_t bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    strbuf_append(code, (const char *)bytes, 4);
+}
+
+static void emit_say(NativeWriter *writer, uint64_t address, uint32_t length)
+{
+    StrBuf *code = &writer->code;
+    put_u8(code, 0xb8); // mov eax, 1 (write)
+    put_u32(code, 1);
+    put_u8(code, 0xbf); // mov edi, 1 (stdout)
+    put_u32(code, 1);
+    put_u8(code, 0x48); // lea rsi, [rip + disp32]
+    put_u8(code, 0x8d);
+    put_u8(code, 0x35);
+    uint64_t next = writer->code_address + code->length + 4;
+    put_u32(code, (uint32_t)(address - next));
+    put_u8(code, 0xba); // mov edx, length
+    put_u32(code, length);
+    put_u8(code, 0x0f); // syscall
+    put_u8(code, 0x05);
+    put_u8(code, 0x48); // test rax, rax
+    put_u8(code, 0x85);
+    put_u8(code, 0xc0);
+    put_u8(code, 0x0f); // js write_error
+    put_u8(code, 0x88);
+    put_u32(code, writer->write_error - (uint32_t)(code->length + 4));
+}
+
+static void emit_call(NativeWriter *writer, uint32_t target)
+{
+    put_u8(&writer->code, 0xe8);
+    put_u32(&writer->code, target - (uint32_t)(writer->code.length + 4));
+}
+
+static void emit_exit(NativeWriter *writer)
+{
+    StrBuf *code = &writer->code;
+    put_u8(code, 0xb8); // mov eax, 231 (exit_group)
+    put_u32(code, 231);
+    put_u8(code, 0x31); // xor edi, edi
+    put_u8(code, 0xff);
+    put_u8(code, 0x0f); // syscall
+    put_u8(code, 0x05);
+}
+
+// write返回负的错误码时以状态1退出，和写stdout失败的C程序一样报告错误
+static void emit_write_error(NativeWriter *writer)
+{
+    StrBuf *code = &writer->code;
+    put_u8(code, 0xb8); // mov eax, 231 (exit_group)
+    put_u32(code, 231);
+    put_u8(code, 0xbf); // mov edi, 1
+    put_u32(code, 1);
+    put_u8(code, 0x0f); // syscall
+    put_u8(code, 0x05);
+}
+
+// 一条语句的机器码；root为真时是main里的语句
+static void emit_statement(NativeWriter *writer, uint32_t node, int root)
+{
+    const FlatAST *ast = writer->ast;
+    if (ast->kinds[node] == STMT_FUNCTION_CALL)
+    {
+        emit_call(writer, function_offset(writer, ast->payload[node]));
+        return;
+    }
+    if (ast->kinds[node] != STMT_SAY)
+        return;
+
+    const char *text = flat_ast_string(ast, node);
+    uint32_t length = ast->payload_length[node];
+    if (root && memchr(text, '\\', length))
+    {
+        // 解码后的字符串加上换行放在额外区域
+        uint64_t address = writer->extra_address + writer->extra.length;
+        size_t start = writer->extra.length;
+        decode_c_literal(text, length, &writer->extra);
+        strbuf_append(&writer->extra, "\n", 1);
+        emit_say(writer, address, (uint32_t)(writer->extra.length - start));
+        return;
+    }
+    // 池里每个字符串后面的'\0'在输出文件中换成了'\n'，字符串和换行正好连在一起
+    emit_say(writer, writer->pool_address + ast->payload[node], length + 1);
+}
+
+static uint32_t statement_size(const FlatAST *ast, uint32_t node)
+{
+    if (ast->kinds[node] == STMT_SAY)
+        return SAY_SIZE;
+    if (ast->kinds[node] == STMT_FUNCTION_CALL)
+        return CALL_SIZE;
+    return 0;
+}
+
+int emit_native_executable(const FlatAST *ast, StrBuf *output)
+{
+    NativeWriter writer;
+    writer.ast = ast;
+    strbuf_init(&writer.code);
+    strbuf_init(&writer.extra);
+    writer.functions = malloc((ast->root_count ? ast->root_count : 1) * sizeof(NativeFunction));
+    writer.function_count = 0;
+    if (!writer.functions)
+        return -1;
+
+    // 第一遍：main在最前面，然后是写失败时的退出代码，后面依次是各个函数，算出每段代码的偏移
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            size += statement_size(ast, i);
+    }
+    size += EXIT_SIZE;
+    writer.write_error = (uint32_t)size;
+    size += WRITE_ERROR_SIZE;
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            continue;
+        writer.functions[writer.function_count].name = ast->payload[i];
+        writer.functions[writer.function_count].offset = (uint32_t)size;
+        writer.function_count++;
+        uint32_t end = ast->first_child[i] + ast->child_count[i];
+        for (uint32_t stmt = ast->first_child[i]; stmt < end; stmt++)
+            size += statement_size(ast, stmt);
+        size += RET_SIZE;
+    }
+    // rel32和disp32够不着的程序直接放弃
+    if (size + ast->strings_size > INT32_MAX / 2)
+    {
+        free(writer.functions);
+        return -1;
+    }
+    qsort(writer.functions, writer.function_count, sizeof(NativeFunction), compare_function);
+    writer.code_address = NATIVE_BASE + HEADERS_SIZE;
+    writer.pool_address = writer.code_address + size;
+    writer.extra_address = writer.pool_address + ast->strings_size;
+
+    // 第二遍：生成代码
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            emit_statement(&writer, i, 1);
+    }
+    emit_exit(&writer);
+    emit_write_error(&writer);
+    for (uint32_t i = 0; i < ast->root_count; i++)
+    {
+        if (ast->kinds[i] != STMT_FUNCTION_DEF)
+            continue;
+        uint32_t end = ast->first_child[i] + ast->child_count[i];
+        for (uint32_t stmt = ast->first_child[i]; stmt < end; stmt++)
+            emit_statement(&writer, stmt, 0);
+        put_u8(&writer.code, 0xc3);
+    }
+
+    // 单个可读可执行的PT_LOAD段覆盖整个文件：ELF头、程序头、代码、字符串。
+    // 再加一个PT_GNU_STACK，栈不可执行
+    uint64_t file_size = HEADERS_SIZE + writer.code.length + ast->strings_size + writer.extra.length;
+    Elf64_Ehdr header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_EXEC;
+    header.e_machine = EM_X86_64;
+    header.e_version = EV_CURRENT;
+    header.e_entry = writer.code_address;
+    header.e_phoff = sizeof(Elf64_Ehdr);
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = 2;
+
+    Elf64_Phdr segment;
+    memset(&segment, 0, sizeof(segment));
+    segment.p_type = PT_LOAD;
+    segment.p_flags = PF_R | PF_X;
+    segment.p_offset = 0;
+    segment.p_vaddr = NATIVE_BASE;
+    segment.p_paddr = NATIVE_BASE;
+    segment.p_filesz = file_size;
+    segment.p_memsz = file_size;
+    segment.p_align = 0x1000;
+
+    Elf64_Phdr stack;
+    memset(&stack, 0, sizeof(stack));
+    stack.p_type = PT_GNU_STACK;
+    stack.p_flags = PF_R | PF_W;
+    stack.p_align = 0x10;
+
+    strbuf_reserve(output, file_size);
+    strbuf_append(output, (const char *)&header, sizeof(header));
+    strbuf_append(output, (const char *)&segment, sizeof(segment));
+    strbuf_append(output, (const char *)&stack, sizeof(stack));
+    strbuf_append(output, writer.code.data, writer.code.length);
+    size_t pool_start = output->length;
+    if (ast->strings_size > 0)
+        strbuf_append(output, ast->strings, ast->strings_size);
+    for (size_t i = pool_start; i < output->length; i++)
+    {
+        if (output->data[i] == '\0')
+            output->data[i] = '\n';
+    }
+    if (writer.extra.length > 0)
+        strbuf_append(output, writer.extra.data, writer.extra.length);
+
+    strbuf_free(&writer.code);
+    strbuf_free(&writer.extra);
+    free(writer.functions);
+    return 0;
+}
@@ -0,0 +1,363 @@
+#include "optimize.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *allocate(size_t size)
+{
+    void *memory = calloc(1, size ? size : 1);
+    if (!memory)
+    {
+        fprintf(stderr, "Memory allocation failed in optimizer\n");
+        exit(1);
+    }
+    return memory;
+}
+
+// 函数在符号表里的槽位下标，用来给每个函数附加标记
+static uint32_t function_slot(const SymbolTable *functions, const char *name)
+{
+    FunctionDef *def = find_function(functions, name);
+    return def ? (uint32_t)(def - functions->entries) : UINT32_MAX;
+}
+
+// 调用图遍历用的工作栈，只放还没处理过的函数定义
+typedef struct Worklist
+{
+    const ASTNode **items;
+    uint32_t count;
+    uint8_t *reachable; // 按符号表槽位
+} Worklist;
+
+static void mark(Worklist *work, const SymbolTable *functions, const ASTNode *def)
+{
+    uint32_t slot = function_slot(functions, def->value);
+    if (slot == UINT32_MAX || work->reachable[slot])
+        return;
+    work->reachable[slot] = 1;
+    work->items[work->count++] = def;
+}
+
+static void mark_calls(Worklist *work, const SymbolTable *functions, ASTNode *const *body, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const ASTNode *node = body[i];
+        if (node->type != STMT_FUNCTION_CALL)
+            continue;
+        if (node->target)
+            mark(work, functions, node->target);
+        else
+        {
+            FunctionDef *def = find_function(functions, node->value);
+            if (def)
+                mark(work, functions, def->node);
+        }
+    }
+}
+
+static int is_identifier_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// C前导代码里直接调用的HerCode函数：找所有完整的function_<标识符>
+static void mark_prelude_calls(Worklist *work, const SymbolTable *functions, const InternTable *strings,
+                               const char *c_header, size_t c_header_length)
+{
+    static const char prefix[] = "function_";
+    const size_t prefix_length = sizeof(prefix) - 1;
+    const char *end = c_header + c_header_length;
+    const char *p = c_header;
+    while ((size_t)(end - p) > prefix_length && (p = memchr(p, 'f', end - p - prefix_length)) != NULL)
+    {
+        if ((p > c_header && is_identifier_char(p[-1])) || memcmp(p, prefix, prefix_length) != 0)
+        {
+            p++;
+            continue;
+        }
+        const char *name = p + prefix_length;
+        const char *name_end = name;
+        while (name_end < end && is_identifier_char(*name_end))
+            name_end++;
+        // 没驻留过的名字不可能是HerCode函数，只查表不插入
+        const char *interned = name_end > name ? intern_lookup(strings, name, name_end - name) : NULL;
+        FunctionDef *def = interned ? find_function(functions, interned) : NULL;
+        if (def)
+            mark(work, functions, def->node);
+        p = name_end;
+    }
+}
+
+int remove_unreachable_functions(ASTNode **nodes, int count, const SymbolTable *functions,
+                                 const InternTable *strings, const char *c_header, size_t c_header_length,
+                                 ASTNode **removed, int *removed_count)
+{
+    int removed_total = 0;
+    if (functions->count == 0)
+    {
+        if (removed_count)
+            *removed_count = 0;
+        return count;
+    }
+
+    Worklist work;
+    work.items = allocate(functions->count * sizeof(ASTNode *));
+    work.count = 0;
+    work.reachable = allocate(functions->capacity);
+
+    // 根是main里的调用和C前导代码里的调用，之后按工作栈逐个展开函数体
+    mark_calls(&work, functions, nodes, count);
+    if (c_header)
+        mark_prelude_calls(&work, functions, strings, c_header, c_header_length);
+    while (work.count > 0)
+    {
+        const ASTNode *def = work.items[--work.count];
+        mark_calls(&work, functions, def->body, def->body_count);
+    }
+
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *node = nodes[i];
+        if (node->type == STMT_FUNCTION_DEF && !work.reachable[function_slot(functions, node->value)])
+        {
+            if (removed)
+                removed[removed_total] = node;
+            removed_total++;
+            continue;
+        }
+        nodes[kept++] = node;
+    }
+
+    free(work.items);
+    free(work.reachable);
+    if (removed_count)
+        *removed_count = removed_total;
+    return kept;
+}
+
+// 内联时每个函数的状态，按符号表槽位存放
+typedef struct InlineInfo
+{
+    int index;   // Tarjan遍历序号，-1表示还没访问
+    int lowlink;
+    int on_stack;
+    int call_sites;
+    int inlinable;
+    int has_escape; // 函数体里有含反斜杠的say
+} InlineInfo;
+
+typedef struct InlineState
+{
+    const SymbolTable *functions;
+    Arena *arena;
+    InlineInfo *info;
+    int max_statements;
+    int inlined_calls;
+} InlineState;
+
+static ASTNode *call_target(const SymbolTable *functions, const ASTNode *call)
+{
+    if (call->target)
+        return call->target;
+    FunctionDef *def = find_function(functions, call->value);
+    return def ? def->node : NULL;
+}
+
+// 调用处可以展开时返回被调函数的信息
+static InlineInfo *inline_candidate(InlineState *state, const ASTNode *node, int into_main)
+{
+    if (node->type != STMT_FUNCTION_CALL)
+        return NULL;
+    ASTNode *callee = call_target(state->functions, node);
+    if (!callee)
+        return NULL;
+    InlineInfo *info = &state->info[function_slot(state->functions, callee->value)];
+    if (!info->inlinable || (into_main && info->has_escape))
+        return NULL;
+    return info;
+}
+
+// 把可以展开的调用替换成被调函数的函数体，没有可展开的调用时返回原数组。
+// 嵌套的函数定义不产生任何代码，展开时直接丢掉，免得在main里变成顶层定义
+static ASTNode **expand_calls(InlineState *state, ASTNode **body, int *count, int into_main)
+{
+    int expanded = 0, grown = 0;
+    for (int i = 0; i < *count; i++)
+    {
+        if (inline_candidate(state, body[i], into_main))
+        {
+            expanded++;
+            grown += call_target(state->functions, body[i])->body_count - 1;
+        }
+    }
+    if (expanded == 0)
+        return body;
+
+    ASTNode **result = arena_alloc(state->arena, sizeof(ASTNode *) * (*count + grown > 0 ? *count + grown : 1));
+    int length = 0;
+    for (int i = 0; i < *count; i++)
+    {
+        if (!inline_candidate(state, body[i], into_main))
+        {
+            result[length++] = body[i];
+            continue;
+        }
+        const ASTNode *callee = call_target(state->functions, body[i]);
+        for (int j = 0; j < callee->body_count; j++)
+        {
+            if (callee->body[j]->type != STMT_FUNCTION_DEF)
+                result[length++] = callee->body[j];
+        }
+    }
+    state->inlined_calls += expanded;
+    *count = length;
+    return result;
+}
+
+// 函数所在的强连通分量已经完整，它调用的其他函数都处理过了：先展开它的函数体，再决定它能不能被展开
+static void finish_function(InlineState *state, ASTNode *def, int recursive)
+{
+    InlineInfo *info = &state->info[function_slot(state->functions, def->value)];
+    def->body = expand_calls(state, def->body, &def->body_count, 0);
+    int statements = 0;
+    for (int i = 0; i < def->body_count; i++)
+    {
+        const ASTNode *node = def->body[i];
+        if (node->type == STMT_FUNCTION_DEF)
+            continue;
+        statements++;
+        if (node->type == STMT_SAY && memchr(node->value, '\\', intern_length(node->value)))
+            info->has_escape = 1;
+    }
+    info->inlinable = !recursive && (statements <= state->max_statements || info->call_sites == 1);
+}
+
+// Tarjan强连通分量算法，用显式栈代替递归。分量按"被调用者在前"的顺序完成
+typedef struct TarjanFrame
+{
+    ASTNode *def;
+    int next; // 下一个要看的函数体语句
+} TarjanFrame;
+
+static void visit_functions(InlineState *state, ASTNode *root, TarjanFrame *frames, ASTNode **component,
+                            int *component_count, int *next_index)
+{
+    const SymbolTable *functions = state->functions;
+    int depth = 0;
+    InlineInfo *root_info = &state->info[function_slot(functions, root->value)];
+    root_info->index = root_info->lowlink = (*next_index)++;
+    root_info->on_stack = 1;
+    component[(*component_count)++] = root;
+    frames[depth++] = (TarjanFrame){root, 0};
+
+    while (depth > 0)
+    {
+        TarjanFrame *frame = &frames[depth - 1];
+        InlineInfo *info = &state->info[function_slot(functions, frame->def->value)];
+        if (frame->next < frame->def->body_count)
+        {
+            const ASTNode *node = frame->def->body[frame->next++];
+            ASTNode *callee = node->type == STMT_FUNCTION_CALL ? call_target(functions, node) : NULL;
+            if (!callee)
+                continue;
+            InlineInfo *callee_info = &state->info[function_slot(functions, callee->value)];
+            if (callee_info->index < 0)
+            {
+                callee_info->index = callee_info->lowlink = (*next_index)++;
+                callee_info->on_stack = 1;
+                component[(*component_count)++] = callee;
+                frames[depth++] = (TarjanFrame){callee, 0};
+            }
+            else if (callee_info->on_stack && callee_info->index < info->lowlink)
+            {
+                info->lowlink = callee_info->index;
+            }
+            continue;
+        }
+
+        // 函数体看完了：是分量的根就把整个分量出栈处理，否则把lowlink传给调用者
+        depth--;
+        if (info->lowlink == info->index)
+        {
+            int first = *component_count;
+            while (component[first - 1] != frame->def)
+                first--;
+            first--;
+            int size = *component_count - first;
+            int self_call = 0;
+            for (int i = 0; i < frame->def->body_count; i++)
+            {
+                const ASTNode *node = frame->def->body[i];
+                if (node->type == STMT_FUNCTION_CALL && call_target(functions, node) == frame->def)
+                    self_call = 1;
+            }
+            for (int i = first; i < *component_count; i++)
+            {
+                state->info[function_slot(functions, component[i]->value)].on_stack = 0;
+                finish_function(state, component[i], size > 1 || self_call);
+            }
+            *component_count = first;
+        }
+        if (depth > 0)
+        {
+            InlineInfo *caller = &state->info[function_slot(functions, frames[depth - 1].def->value)];
+            if (info->lowlink < caller->lowlink)
+                caller->lowlink = info->lowlink;
+        }
+    }
+}
+
+static void count_call_sites(InlineState *state, ASTNode *const *body, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *callee = body[i]->type == STMT_FUNCTION_CALL ? call_target(state->functions, body[i]) : NULL;
+        if (callee)
+            state->info[function_slot(state->functions, callee->value)].call_sites++;
+    }
+}
+
+ASTNode **inline_functions(ASTNode **nodes, int *count, const SymbolTable *functions, Arena *arena,
+                           int max_statements, int *inlined_calls)
+{
+    InlineState state = {functions, arena, NULL, max_statements, 0};
+    if (functions->count == 0)
+    {
+        if (inlined_calls)
+            *inlined_calls = 0;
+        return nodes;
+    }
+    state.info = allocate(functions->capacity * sizeof(InlineInfo));
+    for (uint32_t i = 0; i < functions->capacity; i++)
+        state.info[i].index = -1;
+
+    count_call_sites(&state, nodes, *count);
+    for (int i = 0; i < *count; i++)
+    {
+        if (nodes[i]->type == STMT_FUNCTION_DEF)
+            count_call_sites(&state, nodes[i]->body, nodes[i]->body_count);
+    }
+
+    TarjanFrame *frames = allocate(functions->count * sizeof(TarjanFrame));
+    ASTNode **component = allocate(functions->count * sizeof(ASTNode *));
+    int component_count = 0, next_index = 0;
+    for (int i = 0; i < *count; i++)
+    {
+        ASTNode *node = nodes[i];
+        if (node->type == STMT_FUNCTION_DEF && state.info[function_slot(functions, node->value)].index < 0)
+            visit_functions(&state, node, frames, component, &component_count, &next_index);
+    }
+    free(frames);
+    free(component);
+
+    // 最后展开main里的调用
+    nodes = expand_calls(&state, nodes, count, 1);
+    free(state.info);
+    if (inlined_calls)
+        *inlined_calls = state.inlined_calls;
+    return nodes;
+}
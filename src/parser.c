@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "trace.h"
+#include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -36,45 +38,136 @@ const char *token_type_to_string(TokenType type)
     }
 }
 
-Parser *new_parser(Lexer *lexer)
+Parser *new_parser(Lexer *lexer, Arena *arena, InternTable *strings)
 {
     Parser *parser = malloc(sizeof(Parser));
     parser->lexer = lexer;
-    parser->current_token = next_token(lexer);
+    parser->arena = arena;
+    parser->strings = strings;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->calls = NULL;
+    parser->call_count = 0;
+    parser->call_capacity = 0;
+    parser->error_count = 0;
+    parser->diagnostics = stderr;
+    symtab_init(&parser->functions);
+    // 一次性把整个HerCode部分切成token数组，之后按下标遍历
+    tokenize(lexer, &parser->tokens);
+    parser->current_token = parser->tokens.tokens;
     parser->current_indent = 0; // 初始缩进深度为0
     return parser;
 }
 
 void free_parser(Parser *parser)
 {
-    free_token(parser->current_token);
-    free(parser->lexer);
+    free_token_array(&parser->tokens);
+    free(parser->scratch);
+    free(parser->calls);
+    symtab_free(&parser->functions);
+    free_lexer(parser->lexer);
     free(parser);
 }
 
-void free_token(Token *token)
+// 向前看n个token，越过末尾时停在EOF上
+Token *peek_token(Parser *parser, int n)
 {
-    if (token)
-    {
-        free(token->value);
-        free(token);
-    }
+    Token *last = parser->tokens.tokens + parser->tokens.count - 1;
+    if (n > last - parser->current_token)
+        return last;
+    return parser->current_token + n;
+}
+
+// 报告错误后直接跳回parse_program，AST和临时数据都由arena/parser统一回收，不会泄漏
+static void syntax_error(Parser *parser, const char *format, ...)
+    __attribute__((format(printf, 2, 3), noreturn));
+
+static void syntax_error(Parser *parser, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(parser->diagnostics, format, args);
+    va_end(args);
+    parser->error_count++;
+    longjmp(parser->on_error, 1);
 }
 
-void eat(Parser *parser, TokenType type)
+static void eat(Parser *parser, TokenType type)
 {
     if (parser->current_token->type == type)
     {
-        free_token(parser->current_token);
-        parser->current_token = next_token(parser->lexer);
+        parser->current_token = peek_token(parser, 1);
     }
     else
     {
-        printf("Syntax error: Expected token type %d (%s), but got token type %d (%s)\n",
-               type, token_type_to_string(type), parser->current_token->type, token_type_to_string(parser->current_token->type));
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected token type %d (%s), but got token type %d (%s)\n",
+                     type, token_type_to_string(type), parser->current_token->type, token_type_to_string(parser->current_token->type));
+    }
+}
+static void push_node(ASTNode ***array, int *count, int *capacity, ASTNode *node)
+{
+    if (*count >= *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        ASTNode **grown = realloc(*array, *capacity * sizeof(ASTNode *));
+        if (!grown)
+        {
+            fprintf(stderr, "Memory reallocation failed for parser node list\n");
+            exit(1);
+        }
+        *array = grown;
+    }
+    (*array)[(*count)++] = node;
+}
+
+// 子节点先压入共享的临时栈，块结束时再一次性复制进arena；嵌套的函数定义各自记住栈底
+static void push_scratch(Parser *parser, ASTNode *node)
+{
+    push_node(&parser->scratch, &parser->scratch_count, &parser->scratch_capacity, node);
+}
+
+// 顶层节点：函数定义顺便登记到符号表，重名在这里就报出来
+static void push_program_node(Parser *parser, ASTNode *node)
+{
+    if (node->type == STMT_FUNCTION_DEF)
+    {
+        FunctionDef *def = symtab_insert(&parser->functions, node->value, node);
+        if (def->node != node)
+        {
+            fprintf(parser->diagnostics, "Error: duplicate definition of function '%s'\n", node->value);
+            parser->error_count++;
+        }
+    }
+    push_scratch(parser, node);
+}
+
+// 所有调用点在解析结束后统一查表，每次查找O(1)
+static void resolve_function_calls(Parser *parser)
+{
+    for (int i = 0; i < parser->call_count; i++)
+    {
+        ASTNode *call = parser->calls[i];
+        FunctionDef *def = find_function(&parser->functions, call->value);
+        if (def)
+        {
+            call->target = def->node;
+        }
+        else
+        {
+            fprintf(parser->diagnostics, "Error: call to undefined function '%s'\n", call->value);
+            parser->error_count++;
+        }
     }
 }
+
+// 驻留当前token的内容，AST只保存这些需要的字符串，相同的名字只存一份
+static const char *intern_token(Parser *parser)
+{
+    return intern(parser->strings, token_text(parser->lexer, *parser->current_token),
+                  parser->current_token->length);
+}
+
 ASTNode *parse_statement(Parser *parser)
 {
     // 跳过无关token
@@ -97,9 +190,9 @@ ASTNode *parse_statement(Parser *parser)
     }
 
     // 打印调试信息
-    printf("[PARSER] parse_statement token: %s (%d)\n",
-           token_type_to_string(parser->current_token->type),
-           parser->current_token->type);
+    TRACE(TRACE_PARSER, "[PARSER] parse_statement token: %s (%d)\n",
+          token_type_to_string(parser->current_token->type),
+          parser->current_token->type);
 
     // 识别不同语句类型
     switch (parser->current_token->type)
@@ -110,13 +203,14 @@ ASTNode *parse_statement(Parser *parser)
         return parse_function_definition(parser);
     case TOKEN_IDENTIFIER:
         return parse_function_call(parser);
+    default:
+        break;
     }
 
     // 未知语句类型
-    fprintf(stderr, "Syntax error: Unknown statement. Got token %d (%s)\n",
-            parser->current_token->type,
-            token_type_to_string(parser->current_token->type));
-    exit(1);
+    syntax_error(parser, "Syntax error: Unknown statement. Got token %d (%s)\n",
+                 parser->current_token->type,
+                 token_type_to_string(parser->current_token->type));
 }
 
 ASTNode *parse_say_statement(Parser *parser)
@@ -126,20 +220,19 @@ ASTNode *parse_say_statement(Parser *parser)
     // 确保下一个token是字符串
     if (parser->current_token->type != TOKEN_STRING)
     {
-        fprintf(stderr, "Syntax error: Expected string after 'say'\n");
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected string after 'say'\n");
     }
 
-    char *str_value = parser->current_token->value ? strdup(parser->current_token->value) : strdup("");
+    const char *str_value = intern_token(parser);
 
     eat(parser, TOKEN_STRING); // 消耗字符串token
 
-    return create_say_node(str_value);
+    return create_say_node(parser->arena, str_value);
 }
 
 ASTNode *parse_function_definition(Parser *parser)
 {
-    printf("[PARSER] Parsing function definition\n");
+    TRACE(TRACE_PARSER, "[PARSER] Parsing function definition\n");
 
     // 消耗 function 关键字
     eat(parser, TOKEN_FUNCTION);
@@ -147,42 +240,27 @@ ASTNode *parse_function_definition(Parser *parser)
     // 检查函数名
     if (parser->current_token->type != TOKEN_IDENTIFIER)
     {
-        fprintf(stderr, "Syntax error: Expected function name after 'function'. Got token %d (%s)\n",
-                parser->current_token->type,
-                token_type_to_string(parser->current_token->type));
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected function name after 'function'. Got token %d (%s)\n",
+                     parser->current_token->type,
+                     token_type_to_string(parser->current_token->type));
     }
-    char *func_name = strdup(parser->current_token->value);
+    const char *func_name = intern_token(parser);
     eat(parser, TOKEN_IDENTIFIER);
-    printf("  Function name: '%s'\n", func_name);
+    TRACE(TRACE_PARSER, "  Function name: '%s'\n", func_name);
 
     // 检查冒号
     if (parser->current_token->type != TOKEN_COLON)
     {
-        fprintf(stderr, "Syntax error: Expected colon after function name. Got token %d (%s)\n",
-                parser->current_token->type,
-                token_type_to_string(parser->current_token->type));
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected colon after function name. Got token %d (%s)\n",
+                     parser->current_token->type,
+                     token_type_to_string(parser->current_token->type));
     }
     eat(parser, TOKEN_COLON);
 
-    // 处理函数定义后的可能空白
-    int first_token = 1;
-
-    // 解析函数体
-    ASTNode **body = NULL;
-    int body_capacity = 8; // 初始容量
-    int body_count = 0;
+    // 解析函数体，语句先放在临时栈上
+    int body_base = parser->scratch_count;
     parser->current_indent = -1; // 标记函数体缩进级别未设置
 
-    // 初始化body数组
-    body = malloc(body_capacity * sizeof(ASTNode *));
-    if (!body)
-    {
-        fprintf(stderr, "Memory allocation failed for function body\n");
-        exit(1);
-    }
-
     // 直到遇到end或DEDENT
     while (1)
     {
@@ -195,8 +273,8 @@ ASTNode *parse_function_definition(Parser *parser)
             if (parser->current_token->type == TOKEN_INDENT &&
                 parser->current_indent == -1)
             {
-                parser->current_indent = parser->lexer->indent_stack[parser->lexer->indent_top];
-                printf("  Function body indent set to: %d\n", parser->current_indent);
+                parser->current_indent = parser->current_token->length; // INDENT token覆盖行首空白
+                TRACE(TRACE_PARSER, "  Function body indent set to: %d\n", parser->current_indent);
             }
 
             eat(parser, parser->current_token->type);
@@ -208,35 +286,12 @@ ASTNode *parse_function_definition(Parser *parser)
             break;
         }
 
-        // 如果遇到DEDENT，检查是否已经返回到函数定义层级
-        if (parser->current_token->type == TOKEN_DEDENT &&
-            parser->current_indent != -1 &&
-            parser->lexer->indent_stack[parser->lexer->indent_top] < parser->current_indent)
-        {
-            printf("  Exiting function body at indent: %d (current: %d)\n",
-                   parser->current_indent, parser->lexer->indent_stack[parser->lexer->indent_top]);
-            break;
-        }
-
         // 遇到函数体中的语句
-        printf("  Parsing function body statement (%s)\n", token_type_to_string(parser->current_token->type));
-
-        // 检查并扩展数组容量
-        if (body_count >= body_capacity)
-        {
-            body_capacity *= 2;
-            ASTNode **new_body = realloc(body, body_capacity * sizeof(ASTNode *));
-            if (!new_body)
-            {
-                fprintf(stderr, "Memory reallocation failed for function body\n");
-                exit(1);
-            }
-            body = new_body;
-        }
+        TRACE(TRACE_PARSER, "  Parsing function body statement (%s)\n", token_type_to_string(parser->current_token->type));
 
         // 解析语句并存储
         ASTNode *stmt = parse_statement(parser);
-        body[body_count++] = stmt;
+        push_scratch(parser, stmt);
     }
 
     // 消耗end关键字
@@ -246,22 +301,18 @@ ASTNode *parse_function_definition(Parser *parser)
     }
     else
     {
-        fprintf(stderr, "Syntax error: Expected 'end' to close function definition. Got %d (%s)\n",
-                parser->current_token->type,
-                token_type_to_string(parser->current_token->type));
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected 'end' to close function definition. Got %d (%s)\n",
+                     parser->current_token->type,
+                     token_type_to_string(parser->current_token->type));
     }
 
     // 重置缩进级别
     parser->current_indent = 0;
-    printf("Successfully parsed function '%s' with %d statements\n", func_name, body_count);
+    int body_count = parser->scratch_count - body_base;
+    TRACE(TRACE_PARSER, "Successfully parsed function '%s' with %d statements\n", func_name, body_count);
 
-    ASTNode *result = create_function_def_node(func_name, body, body_count);
-    if (!result)
-    {
-        free(body);
-        return NULL;
-    }
+    ASTNode *result = create_function_def_node(parser->arena, func_name, parser->scratch + body_base, body_count);
+    parser->scratch_count = body_base;
     return result;
 }
 
@@ -269,71 +320,26 @@ ASTNode *parse_function_call(Parser *parser)
 {
     if (parser->current_token->type != TOKEN_IDENTIFIER)
     {
-        fprintf(stderr, "Syntax error: Expected function name\n");
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected function name\n");
     }
 
-    char *func_name = strdup(parser->current_token->value);
+    const char *func_name = intern_token(parser);
     eat(parser, TOKEN_IDENTIFIER);
 
-    return create_function_call_node(func_name);
+    ASTNode *node = create_function_call_node(parser->arena, func_name);
+    push_node(&parser->calls, &parser->call_count, &parser->call_capacity, node);
+    return node;
 }
 
-ASTNode *parse_block(Parser *parser, int *count)
+ASTNode **parse_program(Parser *parser, int *count)
 {
-    *count = 0;
-    ASTNode **nodes = NULL;
-    int nodes_capacity = 0;
-
-    while (1)
-    {
-        // 处理行内Token
-        while (parser->current_token->type == TOKEN_NEWLINE ||
-               parser->current_token->type == TOKEN_INDENT)
-        { // 添加对缩进Token的处理
-            eat(parser, parser->current_token->type);
-        }
-
-        // 块结束检查
-        if (parser->current_token->type == TOKEN_DEDENT ||
-            parser->current_token->type == TOKEN_END)
-        {
-            break;
-        }
-
-        if (*count >= nodes_capacity)
-        {
-            nodes_capacity = nodes_capacity ? nodes_capacity * 2 : 8;
-            ASTNode **new_nodes = realloc(nodes, nodes_capacity * sizeof(ASTNode *));
-            if (!new_nodes)
-            {
-                fprintf(stderr, "Memory reallocation failed for block nodes\n");
-                exit(1);
-            }
-            nodes = new_nodes;
-        }
-        nodes[*count] = parse_statement(parser);
-        (*count)++;
-    }
-    ASTNode *block = create_block_node(nodes, *count);
-    if (!block)
+    int base = parser->scratch_count;
+    if (setjmp(parser->on_error))
     {
-        for (int i = 0; i < *count; i++)
-        {
-            free_node(nodes[i]);
-        }
-        free(nodes);
+        parser->scratch_count = base;
+        *count = 0;
         return NULL;
     }
-    free(nodes);
-    return block;
-}
-
-ASTNode **parse_program(Parser *parser, int *count)
-{
-    *count = 0;
-    ASTNode **nodes = NULL;
-    int nodes_capacity = 0;
 
     // 允许函数定义出现在程序开头
     while (parser->current_token->type != TOKEN_EOF)
@@ -358,32 +364,18 @@ ASTNode **parse_program(Parser *parser, int *count)
             break;
         }
 
-        // 解析函数定义
-        if (*count >= nodes_capacity)
-        {
-            nodes_capacity = nodes_capacity ? nodes_capacity * 2 : 8;
-            ASTNode **new_nodes = realloc(nodes, nodes_capacity * sizeof(ASTNode *));
-            if (!new_nodes)
-            {
-                fprintf(stderr, "Memory reallocation failed for program nodes\n");
-                exit(1);
-            }
-            nodes = new_nodes;
-        }
-
         // 解析其他语句（包括函数定义）
         ASTNode *node = parse_statement(parser);
         if (node)
         {
-            nodes[(*count)++] = node;
+            push_program_node(parser, node);
         }
     }
 
     // 程序必须以start开始
     if (parser->current_token->type != TOKEN_START)
     {
-        fprintf(stderr, "Syntax error: Program must contain 'start:' block\n");
-        exit(1);
+        syntax_error(parser, "Syntax error: Program must contain 'start:' block\n");
     }
     eat(parser, TOKEN_START); // 消耗start token
 
@@ -396,8 +388,7 @@ ASTNode **parse_program(Parser *parser, int *count)
     // 必须有缩进
     if (parser->current_token->type != TOKEN_INDENT)
     {
-        fprintf(stderr, "Syntax error: Expected indentation after 'start:'\n");
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected indentation after 'start:'\n");
     }
     eat(parser, TOKEN_INDENT);
     parser->current_indent++;
@@ -432,15 +423,8 @@ ASTNode **parse_program(Parser *parser, int *count)
             break;
         }
 
-        // 确保不超过最大语句数
-        if (*count >= nodes_capacity)
-        {
-            nodes_capacity = nodes_capacity ? nodes_capacity * 2 : 8;
-            nodes = realloc(nodes, nodes_capacity * sizeof(ASTNode *));
-        }
-
         // 解析语句
-        nodes[(*count)++] = parse_statement(parser);
+        push_program_node(parser, parse_statement(parser));
     }
 
     // 在缩出循环后，跳过所有换行符和DEDENT
@@ -453,16 +437,14 @@ ASTNode **parse_program(Parser *parser, int *count)
     // 处理end关键字
     if (parser->current_token->type == TOKEN_EOF)
     {
-        fprintf(stderr, "Syntax error: Program must end with 'end'\n");
-        exit(1);
+        syntax_error(parser, "Syntax error: Program must end with 'end'\n");
     }
 
     if (parser->current_token->type != TOKEN_END)
     {
-        fprintf(stderr, "Syntax error: Expected 'end' at end of program. Got token type %d (%s)\n",
-                parser->current_token->type,
-                token_type_to_string(parser->current_token->type));
-        exit(1);
+        syntax_error(parser, "Syntax error: Expected 'end' at end of program. Got token type %d (%s)\n",
+                     parser->current_token->type,
+                     token_type_to_string(parser->current_token->type));
     }
     eat(parser, TOKEN_END);
 
@@ -479,11 +461,24 @@ ASTNode **parse_program(Parser *parser, int *count)
         // 如果还有剩余的缩进级别
         if (parser->current_indent != 0)
         {
-            fprintf(stderr, "Syntax error: Missing dedent at end of program (indent level=%d)\n",
-                    parser->current_indent);
-            exit(1);
+            syntax_error(parser, "Syntax error: Missing dedent at end of program (indent level=%d)\n",
+                         parser->current_indent);
         }
     }
 
+    // 在调用C编译器之前就报告未定义和重复定义的函数
+    resolve_function_calls(parser);
+    if (parser->error_count > 0)
+    {
+        // 这些错误已经计过数了，只打印汇总再跳回，不能再经过syntax_error计一次
+        fprintf(parser->diagnostics, "%d error(s), aborting\n", parser->error_count);
+        longjmp(parser->on_error, 1);
+    }
+
+    // 顶层节点数组同样放进arena
+    *count = parser->scratch_count - base;
+    ASTNode **nodes = arena_alloc(parser->arena, sizeof(ASTNode *) * (*count ? *count : 1));
+    memcpy(nodes, parser->scratch + base, sizeof(ASTNode *) * *count);
+    parser->scratch_count = base;
     return nodes;
 }
@@ -0,0 +1,114 @@
+#include "report.h"
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 本进程加上已回收子进程的CPU时间，这样gcc的耗时也算进编译阶段
+static double cpu_seconds(void)
+{
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    return self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 +
+           self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6 +
+           children.ru_utime.tv_sec + children.ru_utime.tv_usec / 1e6 +
+           children.ru_stime.tv_sec + children.ru_stime.tv_usec / 1e6;
+}
+
+void report_init(TimeReport *report)
+{
+    memset(report, 0, sizeof(TimeReport));
+}
+
+void report_begin(TimeReport *report)
+{
+    report->wall_start = wall_seconds();
+    report->cpu_start = cpu_seconds();
+}
+
+// 结束当前阶段，并立即开始下一个阶段
+void report_end(TimeReport *report, const char *phase)
+{
+    double wall = wall_seconds();
+    double cpu = cpu_seconds();
+    if (report->phase_count < REPORT_MAX_PHASES)
+    {
+        ReportPhase *p = &report->phases[report->phase_count++];
+        p->name = phase;
+        p->wall = wall - report->wall_start;
+        p->cpu = cpu - report->cpu_start;
+    }
+    report->wall_start = wall;
+    report->cpu_start = cpu;
+}
+
+void report_count(TimeReport *report, const char *name, long long value)
+{
+    if (report->counter_count < REPORT_MAX_COUNTERS)
+    {
+        report->counters[report->counter_count].name = name;
+        report->counters[report->counter_count].value = value;
+        report->counter_count++;
+    }
+}
+
+void report_print(const TimeReport *report, FILE *out, int json)
+{
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    // Linux下ru_maxrss的单位是KB
+    long peak_rss_kb = self.ru_maxrss;
+    long child_peak_rss_kb = children.ru_maxrss;
+
+    double total_wall = 0, total_cpu = 0;
+    for (int i = 0; i < report->phase_count; i++)
+    {
+        total_wall += report->phases[i].wall;
+        total_cpu += report->phases[i].cpu;
+    }
+
+    if (json)
+    {
+        fprintf(out, "{\n  \"phases\": [\n");
+        for (int i = 0; i < report->phase_count; i++)
+        {
+            const ReportPhase *p = &report->phases[i];
+            fprintf(out, "    {\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f}%s\n",
+                    p->name, p->wall * 1e3, p->cpu * 1e3, i + 1 < report->phase_count ? "," : "");
+        }
+        fprintf(out, "  ],\n  \"total_wall_ms\": %.3f,\n  \"total_cpu_ms\": %.3f,\n", total_wall * 1e3, total_cpu * 1e3);
+        fprintf(out, "  \"counters\": {\n");
+        for (int i = 0; i < report->counter_count; i++)
+        {
+            fprintf(out, "    \"%s\": %lld,\n", report->counters[i].name, report->counters[i].value);
+        }
+        fprintf(out, "    \"peak_rss_kb\": %ld,\n    \"child_peak_rss_kb\": %ld\n  }\n}\n",
+                peak_rss_kb, child_peak_rss_kb);
+        return;
+    }
+
+    fprintf(out, "===== HerCode time report =====\n");
+    fprintf(out, "%-16s %12s %12s %8s\n", "phase", "wall (ms)", "cpu (ms)", "wall %");
+    for (int i = 0; i < report->phase_count; i++)
+    {
+        const ReportPhase *p = &report->phases[i];
+        fprintf(out, "%-16s %12.3f %12.3f %7.1f%%\n", p->name, p->wall * 1e3, p->cpu * 1e3,
+                total_wall > 0 ? p->wall / total_wall * 100 : 0);
+    }
+    fprintf(out, "%-16s %12.3f %12.3f\n", "total", total_wall * 1e3, total_cpu * 1e3);
+    fprintf(out, "\n");
+    for (int i = 0; i < report->counter_count; i++)
+    {
+        fprintf(out, "%-24s %14lld\n", report->counters[i].name, report->counters[i].value);
+    }
+    fprintf(out, "%-24s %14ld\n", "peak_rss_kb", peak_rss_kb);
+    fprintf(out, "%-24s %14ld\n", "child_peak_rss_kb", child_peak_rss_kb);
+}
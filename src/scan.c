@@ -0,0 +1,122 @@
+#include "scan.h"
+#include <stdint.h>
+
+// 定义HERCODE_SCALAR_SCAN可以强制使用逐字节的实现，便于对比性能。
+// x86上SSE2是基线，AVX2版本用target属性单独编译，运行时按CPU选用
+#if !defined(HERCODE_SCALAR_SCAN) && defined(__SSE2__)
+#define SCAN_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_AVX2
+#endif
+#endif
+
+#if defined(SCAN_SSE2)
+#include <immintrin.h>
+#endif
+
+#if defined(SCAN_AVX2)
+
+// 按32字节对齐读取，对齐的读取不会跨页，所以越过'\0'读几个字节是安全的
+__attribute__((target("avx2"))) static const char *scan_until_avx2(const char *p, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vz = _mm256_setzero_si256();
+    unsigned offset = (uintptr_t)p & 31;
+    const char *block = p - offset;
+    unsigned mask = ~0u << offset; // 屏蔽掉p之前的字节
+
+    while (1)
+    {
+        __m256i chunk = _mm256_load_si256((const __m256i *)block);
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va),
+                                                       _mm256_cmpeq_epi8(chunk, vb)),
+                                       _mm256_cmpeq_epi8(chunk, vz));
+        mask &= (unsigned)_mm256_movemask_epi8(hits);
+        if (mask)
+            return block + __builtin_ctz(mask);
+        block += 32;
+        mask = ~0u;
+    }
+}
+
+#endif
+
+#if defined(SCAN_SSE2) && !defined(__AVX2__)
+
+// 按16字节对齐读取，对齐的读取不会跨页，所以越过'\0'读几个字节是安全的
+static const char *scan_until_sse2(const char *p, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vz = _mm_setzero_si128();
+    unsigned offset = (uintptr_t)p & 15;
+    const char *block = p - offset;
+    unsigned mask = ~0u << offset; // 屏蔽掉p之前的字节
+
+    while (1)
+    {
+        __m128i chunk = _mm_load_si128((const __m128i *)block);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+                                                 _mm_cmpeq_epi8(chunk, vb)),
+                                    _mm_cmpeq_epi8(chunk, vz));
+        mask &= (unsigned)_mm_movemask_epi8(hits);
+        if (mask)
+            return block + __builtin_ctz(mask);
+        block += 16;
+        mask = ~0u;
+    }
+}
+
+#endif
+
+#if defined(SCAN_AVX2) && defined(__AVX2__)
+
+// 编译时已经指定了AVX2，不需要再检测
+const char *scan_until(const char *p, char a, char b)
+{
+    return scan_until_avx2(p, a, b);
+}
+
+#elif defined(SCAN_AVX2)
+
+// 加载时检测一次CPU，之后每次调用只是一次间接跳转
+static const char *(*scan_until_impl)(const char *, char, char) = scan_until_sse2;
+
+__attribute__((constructor)) static void select_scan_until(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scan_until_impl = scan_until_avx2;
+}
+
+const char *scan_until(const char *p, char a, char b)
+{
+    return scan_until_impl(p, a, b);
+}
+
+#elif defined(SCAN_SSE2)
+
+const char *scan_until(const char *p, char a, char b)
+{
+    return scan_until_sse2(p, a, b);
+}
+
+#else
+
+const char *scan_until(const char *p, char a, char b)
+{
+    while (*p != a && *p != b && *p != '\0')
+        p++;
+    return p;
+}
+
+#endif
+
+// 空白通常只有几个字节，逐字节判断比向量化更划算
+const char *skip_blanks(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')
+        p++;
+    return p;
+}
@@ -0,0 +1,109 @@
+#include "sha256.h"
+#include <string.h>
+
+// FIPS 180-4 SHA-256
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(Sha256 *hash, const uint8_t *p)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 | (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = hash->state[0], b = hash->state[1], c = hash->state[2], d = hash->state[3];
+    uint32_t e = hash->state[4], f = hash->state[5], g = hash->state[6], h = hash->state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    hash->state[0] += a;
+    hash->state[1] += b;
+    hash->state[2] += c;
+    hash->state[3] += d;
+    hash->state[4] += e;
+    hash->state[5] += f;
+    hash->state[6] += g;
+    hash->state[7] += h;
+}
+
+void sha256_init(Sha256 *hash)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(hash->state, initial, sizeof(initial));
+    hash->bytes = 0;
+    hash->block_used = 0;
+}
+
+void sha256_update(Sha256 *hash, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    hash->bytes += length;
+    if (hash->block_used > 0)
+    {
+        size_t take = 64 - hash->block_used;
+        if (take > length)
+            take = length;
+        memcpy(hash->block + hash->block_used, p, take);
+        hash->block_used += take;
+        p += take;
+        length -= take;
+        if (hash->block_used < 64)
+            return;
+        sha256_block(hash, hash->block);
+        hash->block_used = 0;
+    }
+    // 整块直接从输入里处理，不经过内部缓冲
+    for (; length >= 64; p += 64, length -= 64)
+        sha256_block(hash, p);
+    memcpy(hash->block, p, length);
+    hash->block_used = length;
+}
+
+void sha256_final(Sha256 *hash, uint8_t digest[32])
+{
+    uint64_t bits = hash->bytes * 8;
+    uint8_t pad = 0x80;
+    sha256_update(hash, &pad, 1);
+    pad = 0;
+    while (hash->block_used != 56)
+        sha256_update(hash, &pad, 1);
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++)
+        length[i] = (uint8_t)(bits >> (56 - i * 8));
+    sha256_update(hash, length, 8);
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (uint8_t)(hash->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(hash->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(hash->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)hash->state[i];
+    }
+}
@@ -0,0 +1,171 @@
+#include "source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 映射失败时（例如管道或不支持mmap的平台）退回到整体读入
+static int read_source_file(FILE *file, SourceFile *out)
+{
+    size_t capacity = 1 << 16;
+    size_t size = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer)
+        return -1;
+
+    size_t n;
+    while ((n = fread(buffer + size, 1, capacity - size - 1, file)) > 0)
+    {
+        size += n;
+        if (capacity - size - 1 == 0)
+        {
+            capacity *= 2;
+            char *new_buffer = realloc(buffer, capacity);
+            if (!new_buffer)
+            {
+                free(buffer);
+                return -1;
+            }
+            buffer = new_buffer;
+        }
+    }
+    buffer[size] = '\0';
+    out->data = buffer;
+    out->size = size;
+    out->mapped = 0;
+    return 0;
+}
+
+int open_source_file(const char *filename, SourceFile *out)
+{
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("File opening failed");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        // 词法分析器用int记录偏移
+        if (st.st_size >= INT_MAX)
+        {
+            fprintf(stderr, "File too large: %s\n", filename);
+            close(fd);
+            return -1;
+        }
+
+        // 先预留比文件多至少一个字节的匿名零页，再把文件映射到开头，
+        // 这样即使文件长度恰好是页大小的整数倍，末尾也有'\0'
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (size_t)st.st_size;
+        size_t mapped = (size + 1 + page - 1) / page * page;
+        char *base = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED)
+            {
+                close(fd);
+                out->data = base;
+                out->size = size;
+                out->mapped = mapped;
+                return 0;
+            }
+            munmap(base, mapped);
+        }
+    }
+
+    FILE *file = fdopen(fd, "rb");
+#else
+    FILE *file = fopen(filename, "rb");
+#endif
+    if (!file)
+    {
+        perror("File opening failed");
+        return -1;
+    }
+    int result = read_source_file(file, out);
+    fclose(file);
+    if (result == 0 && out->size >= INT_MAX)
+    {
+        fprintf(stderr, "File too large: %s\n", filename);
+        close_source_file(out);
+        return -1;
+    }
+    return result;
+}
+
+void close_source_file(SourceFile *file)
+{
+#ifndef _WIN32
+    if (file->mapped)
+        munmap((void *)file->data, file->mapped);
+    else
+#endif
+        free((void *)file->data);
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+}
+
+void separate_header(const char *source, size_t size, const char *magic_string,
+                     const char **c_header, size_t *c_header_length,
+                     const char **hercode_source)
+{
+    *c_header = NULL;
+    *c_header_length = 0;
+    *hercode_source = NULL;
+
+    // 只比较每一行的开头，用memchr跳到下一行
+    size_t magic_length = strlen(magic_string);
+    const char *end = source + size;
+    const char *line = source;
+    const char *magic_pos = NULL;
+    while (line < end)
+    {
+        if ((size_t)(end - line) >= magic_length && memcmp(line, magic_string, magic_length) == 0)
+        {
+            magic_pos = line;
+            break;
+        }
+        const char *newline = memchr(line, '\n', end - line);
+        if (newline == NULL)
+            break;
+        line = newline + 1;
+    }
+    if (magic_pos == NULL)
+    {
+        return; // 没有找到特殊字符串
+    }
+
+    // C头部分就是magic之前的全部内容
+    *c_header = source;
+    *c_header_length = magic_pos - source;
+
+    // 查找行结束位置
+    const char *line_end = memchr(magic_pos, '\n', end - magic_pos);
+    if (line_end == NULL)
+    {
+        // 如果没有换行符，特殊字符串后没有内容
+        *hercode_source = end;
+        return;
+    }
+
+    // HerCode部分从下一行开始
+    *hercode_source = line_end + 1;
+
+    // 特殊处理CRLF换行
+    if (line_end > magic_pos && *(line_end - 1) == '\r')
+    {
+        // 如果前面有CR，跳过它
+        *hercode_source = line_end;
+    }
+}
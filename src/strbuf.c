@@ -0,0 +1,98 @@
+#include "strbuf.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void strbuf_init(StrBuf *buffer)
+{
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->allocations = 0;
+}
+
+void strbuf_free(StrBuf *buffer)
+{
+    free(buffer->data);
+    strbuf_init(buffer);
+}
+
+void strbuf_reset(StrBuf *buffer)
+{
+    buffer->length = 0;
+    if (buffer->data)
+        buffer->data[0] = '\0';
+}
+
+// 保证还能再放下extra个字节和结尾的'\0'
+void strbuf_reserve(StrBuf *buffer, size_t extra)
+{
+    size_t needed = buffer->length + extra + 1;
+    if (needed <= buffer->capacity)
+        return;
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity < needed)
+        capacity *= 2;
+    char *data = realloc(buffer->data, capacity);
+    if (!data)
+    {
+        fprintf(stderr, "Memory allocation failed for output buffer\n");
+        exit(1);
+    }
+    buffer->allocations++;
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+void strbuf_printf(StrBuf *buffer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t room = buffer->capacity > buffer->length ? buffer->capacity - buffer->length : 0;
+    int length = vsnprintf(room ? buffer->data + buffer->length : NULL, room, format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    if ((size_t)length >= room)
+    {
+        // 第一次没放下，扩容后重新格式化
+        strbuf_reserve(buffer, length);
+        va_start(args, format);
+        vsnprintf(buffer->data + buffer->length, length + 1, format, args);
+        va_end(args);
+    }
+    buffer->length += length;
+}
+
+int strbuf_write_fd(const StrBuf *buffer, int fd)
+{
+    const char *p = buffer->data;
+    size_t left = buffer->length;
+    while (left > 0)
+    {
+        ssize_t written = write(fd, p, left);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += written;
+        left -= written;
+    }
+    return 0;
+}
+
+int strbuf_write_file(const StrBuf *buffer, const char *path, int mode)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0)
+        return -1;
+    int result = strbuf_write_fd(buffer, fd);
+    if (close(fd) != 0)
+        result = -1;
+    return result;
+}
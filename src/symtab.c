@@ -0,0 +1,81 @@
+#include "symtab.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// 名字都是驻留过的，直接用驻留ID做乘法哈希，不用再扫一遍字符串
+static uint32_t hash_name(const char *name)
+{
+    return intern_id(name) * 2654435761u;
+}
+
+void symtab_init(SymbolTable *table)
+{
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->allocations = 0;
+}
+
+void symtab_free(SymbolTable *table)
+{
+    free(table->entries);
+    symtab_init(table);
+}
+
+static FunctionDef *find_slot(FunctionDef *entries, uint32_t capacity, const char *name, uint32_t hash)
+{
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        FunctionDef *entry = &entries[i];
+        if (entry->name == NULL || entry->name == name)
+            return entry;
+    }
+}
+
+// 装载因子超过一半就扩容，保证探测序列很短
+static void grow(SymbolTable *table)
+{
+    uint32_t capacity = table->capacity ? table->capacity * 2 : 64;
+    FunctionDef *entries = calloc(capacity, sizeof(FunctionDef));
+    if (!entries)
+    {
+        fprintf(stderr, "Memory allocation failed for symbol table\n");
+        exit(1);
+    }
+    table->allocations++;
+    for (uint32_t i = 0; i < table->capacity; i++)
+    {
+        FunctionDef *old = &table->entries[i];
+        if (old->name)
+            *find_slot(entries, capacity, old->name, old->hash) = *old;
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+FunctionDef *symtab_insert(SymbolTable *table, const char *name, ASTNode *node)
+{
+    if ((table->count + 1) * 2 > table->capacity)
+        grow(table);
+
+    uint32_t hash = hash_name(name);
+    FunctionDef *entry = find_slot(table->entries, table->capacity, name, hash);
+    if (entry->name == NULL)
+    {
+        entry->name = name;
+        entry->hash = hash;
+        entry->node = node;
+        table->count++;
+    }
+    return entry;
+}
+
+FunctionDef *find_function(const SymbolTable *table, const char *name)
+{
+    if (table->count == 0)
+        return NULL;
+    FunctionDef *entry = find_slot(table->entries, table->capacity, name, hash_name(name));
+    return entry->name ? entry : NULL;
+}
@@ -0,0 +1,55 @@
+#include "trace.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+unsigned trace_mask = 0;
+
+static const struct
+{
+    const char *name;
+    unsigned mask;
+} trace_categories[] = {
+    {"lexer", TRACE_LEXER},
+    {"parser", TRACE_PARSER},
+    {"driver", TRACE_DRIVER},
+    {"all", TRACE_ALL},
+};
+
+int trace_enable(const char *categories)
+{
+    const char *p = categories;
+    while (*p)
+    {
+        size_t length = strcspn(p, ",");
+        int found = 0;
+        for (size_t i = 0; i < sizeof(trace_categories) / sizeof(trace_categories[0]); i++)
+        {
+            if (strlen(trace_categories[i].name) == length &&
+                strncmp(trace_categories[i].name, p, length) == 0)
+            {
+                trace_mask |= trace_categories[i].mask;
+                found = 1;
+                break;
+            }
+        }
+        if (!found)
+        {
+            fprintf(stderr, "Unknown trace category: %.*s\n", (int)length, p);
+            return -1;
+        }
+        p += length;
+        if (*p == ',')
+            p++;
+    }
+    return 0;
+}
+
+// 跟踪信息写到stderr，不和程序的正常输出混在一起
+void trace_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
@@ -0,0 +1,80 @@
+#include "bytecode.h"
+#include "interp.h"
+#include <stdlib.h>
+
+// 线程化分派：每条指令执行完直接跳到下一条指令的处理代码，没有中心循环。
+// 字节码在加载时已经校验过，这里不做边界检查
+int vm_run(const Bytecode *bytecode, FILE *out, FILE *diagnostics)
+{
+    static const void *const dispatch[OP_COUNT] = {
+        [OP_SAY] = &&op_say,
+        [OP_CALL] = &&op_call,
+        [OP_TAIL] = &&op_tail,
+        [OP_RET] = &&op_ret,
+        [OP_HALT] = &&op_halt,
+    };
+    const uint32_t *code = bytecode->code;
+    const char *strings = bytecode->strings;
+    const HcbFunction *functions = bytecode->functions;
+
+    uint32_t capacity = 64;
+    uint32_t *returns = malloc(capacity * sizeof(uint32_t)); // 返回地址栈
+    if (!returns)
+    {
+        fprintf(diagnostics, "Memory allocation failed\n");
+        return 1;
+    }
+    uint32_t depth = 0;
+    uint32_t pc = bytecode->header->entry;
+    int status = 0;
+
+#define DISPATCH() goto *dispatch[code[pc]]
+    DISPATCH();
+
+op_say:
+    fwrite(strings + code[pc + 1], 1, code[pc + 2], out);
+    pc += 3;
+    DISPATCH();
+
+op_call:
+    if (depth == capacity)
+    {
+        // 和--run的AST解释器一样限制调用深度
+        if (capacity >= INTERP_MAX_DEPTH)
+        {
+            const HcbFunction *function = &functions[code[pc + 1]];
+            fprintf(diagnostics, "Error: call stack overflow in function '%.*s'\n",
+                    (int)function->name_length, strings + function->name);
+            status = 1;
+            goto op_halt;
+        }
+        capacity *= 2;
+        uint32_t *grown = realloc(returns, capacity * sizeof(uint32_t));
+        if (!grown)
+        {
+            fprintf(diagnostics, "Memory allocation failed\n");
+            status = 1;
+            goto op_halt;
+        }
+        returns = grown;
+    }
+    returns[depth++] = pc + 2;
+    pc = functions[code[pc + 1]].code;
+    DISPATCH();
+
+op_tail:
+    pc = functions[code[pc + 1]].code;
+    DISPATCH();
+
+op_ret:
+    if (depth == 0)
+        goto op_halt;
+    pc = returns[--depth];
+    DISPATCH();
+
+op_halt:
+#undef DISPATCH
+    fflush(out);
+    free(returns);
+    return status;
+}
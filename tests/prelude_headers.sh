@@ -0,0 +1,30 @@
+#!/bin/sh
+# 用法：prelude_headers.sh <hercode_compiler> <tests目录>
+# C前导代码里有表外的名字（int8_t、realpath、drand48……）时要包含全部头文件，
+# 全是认识的名字时只包含用到的头文件；两种情况生成的C都不能有隐式声明
+compiler=$1
+tests=$2
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+fail=0
+
+check()
+{
+    name=$1
+    expected=$2
+    "$compiler" --no-cache --emit-c="$work/$name.c" "$tests/$name.hercode" "$work/$name" >/dev/null || { echo "$name: compile failed"; fail=1; return; }
+    gcc -fsyntax-only -Werror=implicit-function-declaration "$work/$name.c" || { echo "$name: implicit declaration"; fail=1; }
+    output=$("$work/$name")
+    if [ "$output" != "$expected" ]; then
+        echo "$name: expected '$expected', got '$output'"
+        fail=1
+    fi
+}
+
+check prelude_unknown_names "-3 / 1 1
+x"
+check prelude_known_names "1 2 3 7 1
+x"
+grep -q '#include <locale.h>' "$work/prelude_unknown_names.c" || { echo "prelude_unknown_names: full header set expected"; fail=1; }
+grep -q '#include <stdlib.h>' "$work/prelude_known_names.c" && { echo "prelude_known_names: stdlib.h should be trimmed"; fail=1; }
+exit $fail